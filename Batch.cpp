@@ -0,0 +1,244 @@
+#include "Batch.hpp"
+
+#include "Rng.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+//one sheep in each of a block of games, copied out of the lanes so the per-lane loops below
+// work on arrays the compiler knows nothing else touches (and so vectorizes):
+struct BatchSheep {
+	float x[BATCH_LANES], y[BATCH_LANES];
+	int32_t dir[BATCH_LANES];
+};
+
+//Flock::dir_x/dir_y, worked out from the bits of the Flock::Direction (comparisons here get the
+// per-lane loops split into branches before the vectorizer sees them):
+static float dir_x(int32_t d){ return float((1 - 2*(d & 1)) * (1 - (d >> 1))); }
+static float dir_y(int32_t d){ return float((1 - 2*(d & 1)) * (d >> 1)); }
+
+//c ? a : b, for c 0 or 1, without a branch:
+static int32_t pick(int32_t c, int32_t a, int32_t b){ return b ^ ((a ^ b) & -c); }
+
+BatchWorld::BatchWorld(uint32_t games_, int sheep_, uint32_t seed_) : games(games_) {
+	//everything but the directions is the same for every game, so take it from one World:
+	World start(sheep_, seed_);
+	sheep = start.flock.size();
+	radius = start.radius;
+	obstacles = start.obstacles;
+	start_x = start.flock.x;
+	start_y = start.flock.y;
+	start_speed = start.speed;
+	start_dog = start.dogs[0];
+	switch_slot = start.switches.slot_time;
+
+	stride = (games + BATCH_LANES-1) / BATCH_LANES * BATCH_LANES;
+	game_over.assign(stride, 1);
+	total_time.assign(stride, 0.0f);
+	speed.assign(stride, start_speed);
+	seed.assign(stride, 0);
+	tick.assign(stride, 0);
+	dogs.assign(stride, start_dog);
+	x.assign(size_t(sheep) * stride, 0.0f);
+	y.assign(size_t(sheep) * stride, 0.0f);
+	switched_at.assign(size_t(sheep) * stride, 0.0f);
+	dir.assign(size_t(sheep) * stride, 0);
+	dog_touch.assign(size_t(sheep) * stride, 0);
+	for(uint32_t k=0;k<games;k++) reset(k, seed_ + k);
+}
+
+void BatchWorld::reset(uint32_t game, uint32_t seed_){
+	//as World's constructor:
+	std::vector< uint8_t > dirs(sheep);
+	random_directions(seed_, 0, sheep, 0, dirs.data());
+	for(uint32_t s=0;s<sheep;s++){
+		size_t at = lane(game, s);
+		x[at] = start_x[s];
+		y[at] = start_y[s];
+		switched_at[at] = 0.0f;
+		dir[at] = dirs[s];
+		dog_touch[at] = 0;
+	}
+	game_over[game] = 0;
+	total_time[game] = 0.0f;
+	speed[game] = start_speed;
+	seed[game] = seed_;
+	tick[game] = 0;
+	dogs[game] = start_dog;
+}
+
+void BatchWorld::unpack(uint32_t game, World &world) const {
+	Flock &flock = world.flock;
+	flock.clear();
+	world.dog_contacts.clear();
+	for(uint32_t s=0;s<sheep;s++){
+		size_t at = lane(game, s);
+		flock.add(glm::vec2(x[at], y[at]), dir[at]);
+		flock.switched_at.back() = switched_at[at];
+		if(dog_touch[at]) world.dog_contacts.emplace_back(World::dog_contact(s, 0));
+	}
+	world.speed = speed[game];
+	world.radius = radius;
+	world.dogs.assign(1, dogs[game]);
+	world.obstacles = obstacles;
+	world.total_time = total_time[game];
+	world.game_over = (game_over[game] != 0);
+	world.seed = seed[game];
+	world.tick = tick[game];
+	world.reschedule();
+}
+
+void BatchWorld::step_all(float elapsed, glm::vec2 const *dog_pos){
+	for(uint32_t k=0;k<games;k++){
+		if(!game_over[k]) dogs[k] = dog_pos[k];
+	}
+	uint32_t blocks = stride / BATCH_LANES;
+	if(pool && pool->size() > 1){
+		pool->parallel_for(blocks, BATCH_GRAIN, [this,elapsed](uint32_t begin, uint32_t end){
+			for(uint32_t b=begin;b<end;b++) step_block(b * BATCH_LANES, elapsed);
+		});
+	}else{
+		for(uint32_t b=0;b<blocks;b++) step_block(b * BATCH_LANES, elapsed);
+	}
+}
+
+void BatchWorld::step_block(uint32_t first, float elapsed){
+	//World::step for each game in the block, one rule at a time across all of them.
+	//games that are over step by zero seconds, and every change of direction is masked by 'live':
+	int32_t live[BATCH_LANES];
+	float dt[BATCH_LANES], now[BATCH_LANES], travel[BATCH_LANES], v[BATCH_LANES];
+	float dog_min_x[BATCH_LANES], dog_min_y[BATCH_LANES], dog_max_x[BATCH_LANES], dog_max_y[BATCH_LANES];
+	uint32_t key[BATCH_LANES], counter[BATCH_LANES];
+	int32_t hit[BATCH_LANES], now_slot[BATCH_LANES], new_slot[BATCH_LANES];
+	float half = DOG_SCALE*radius, width = 2*radius;
+	for(uint32_t l=0;l<BATCH_LANES;l++){
+		uint32_t k = first + l;
+		live[l] = !game_over[k];
+		dt[l] = live[l] ? elapsed : 0.0f;
+		int32_t was_slot = int32_t(total_time[k] / switch_slot);
+		total_time[k] += dt[l];
+		tick[k] += uint32_t(live[l]);
+		now[l] = total_time[k];
+		now_slot[l] = int32_t(now[l] / switch_slot);
+		new_slot[l] = (now_slot[l] > was_slot);
+		v[l] = speed[k];
+		travel[l] = v[l] * dt[l];
+		dog_min_x[l] = dogs[k].x - half;
+		dog_min_y[l] = dogs[k].y - half;
+		dog_max_x[l] = dogs[k].x + half;
+		dog_max_y[l] = dogs[k].y + half;
+		key[l] = rng_hash(seed[k]);
+		counter[l] = tick[k];
+		hit[l] = 0;
+	}
+
+	auto load = [this,first](uint32_t s, BatchSheep *out){
+		size_t at = lane(first, s);
+		std::copy(x.begin() + at, x.begin() + at + BATCH_LANES, out->x);
+		std::copy(y.begin() + at, y.begin() + at + BATCH_LANES, out->y);
+		for(uint32_t l=0;l<BATCH_LANES;l++) out->dir[l] = dir[at+l];
+	};
+	auto store = [this,first](uint32_t s, BatchSheep const &in){
+		size_t at = lane(first, s);
+		std::copy(in.x, in.x + BATCH_LANES, x.begin() + at);
+		std::copy(in.y, in.y + BATCH_LANES, y.begin() + at);
+		for(uint32_t l=0;l<BATCH_LANES;l++) dir[at+l] = uint8_t(in.dir[l]);
+	};
+
+	BatchSheep a, b;
+	for(uint32_t s=0;s<sheep;s++){
+		load(s, &a);
+		//update sheep pos
+		for(uint32_t l=0;l<BATCH_LANES;l++){
+			a.x[l] += dir_x(a.dir[l]) * travel[l];
+			a.y[l] += dir_y(a.dir[l]) * travel[l];
+		}
+
+		//sheep/obstacle collision (fences end the game, rocks turn sheep around)
+		int32_t rock[BATCH_LANES] = { 0 };
+		for(Obstacles::Box const &box : obstacles.boxes){
+			int32_t fence = (box.kind == Obstacles::Fence);
+			for(uint32_t l=0;l<BATCH_LANES;l++){
+				float left = a.x[l] - radius, bottom = a.y[l] - radius;
+				int32_t touch = (left < box.max.x) & (left + width > box.min.x) & (bottom < box.max.y) & (bottom + width > box.min.y);
+				hit[l] |= touch & fence;
+				rock[l] |= touch & !fence;
+			}
+		}
+		for(uint32_t l=0;l<BATCH_LANES;l++){
+			//back to where it was, facing the other way:
+			float back = float(rock[l]) * travel[l];
+			a.x[l] -= dir_x(a.dir[l]) * back;
+			a.y[l] -= dir_y(a.dir[l]) * back;
+			a.dir[l] ^= rock[l] & live[l];
+		}
+
+		//sheep/dog collision (only flip velocity if just collided)
+		uint8_t *touched = dog_touch.data() + lane(first, s);
+		int32_t was[BATCH_LANES], touch[BATCH_LANES];
+		for(uint32_t l=0;l<BATCH_LANES;l++) was[l] = touched[l];
+		for(uint32_t l=0;l<BATCH_LANES;l++){
+			float left = a.x[l] - radius, bottom = a.y[l] - radius;
+			int32_t now_touching = (left < dog_max_x[l]) & (left + width > dog_min_x[l]) & (bottom < dog_max_y[l]) & (bottom + width > dog_min_y[l]);
+			a.dir[l] ^= now_touching & (1 - was[l]) & live[l];
+			touch[l] = pick(live[l], now_touching, was[l]);
+		}
+		for(uint32_t l=0;l<BATCH_LANES;l++) touched[l] = uint8_t(touch[l]);
+		store(s, a);
+	}
+
+	for(uint32_t i=0;i<sheep;i++){
+		load(i, &a);
+		//sheep/sheep collision, against earlier sheep in index order (as World's ordered pass):
+		for(uint32_t j=0;j<i;j++){
+			load(j, &b);
+			for(uint32_t l=0;l<BATCH_LANES;l++){
+				float ax = a.x[l] - radius, ay = a.y[l] - radius, bx = b.x[l] - radius, by = b.y[l] - radius;
+				int32_t touch = (ax < bx + width) & (ax + width > bx) & (ay < by + width) & (ay + width > by);
+				//as World's bounce(), with every case worked out and the right one picked:
+				int32_t da = a.dir[l], db = b.dir[l];
+				float vx1 = dir_x(da)*v[l], vy1 = dir_y(da)*v[l], vx2 = dir_x(db)*v[l], vy2 = dir_y(db)*v[l];
+				float px1 = a.x[l] - vx1*dt[l], py1 = a.y[l] - vy1*dt[l], px2 = b.x[l] - vx2*dt[l], py2 = b.y[l] - vy2*dt[l];
+				int32_t direct = (da == (db ^ 1));
+				float dist_x = px2 - px1, dist_y = py2 - py1;
+				//(one of each pair of products is zero, so these pick a term exactly)
+				float a_y = float(da >> 1), a_x = 1.0f - a_y; //a moves in y, or in x
+				float time1 = fabsf((dist_y*a_y + dist_x*a_x) / (vy1*a_y + vx1*a_x)),
+				      time2 = fabsf((dist_x*a_y + dist_y*a_x) / (vx2*a_y + vy2*a_x));
+				int32_t b_rams = (time1 <= time2);
+				int32_t new_a = pick(direct | (1 - b_rams), da ^ 1, db);
+				int32_t new_b = pick(direct | b_rams, db ^ 1, da);
+				float back = float(touch) * dt[l]; //(only bouncing sheep go back)
+				a.x[l] -= vx1*back;
+				a.y[l] -= vy1*back;
+				b.x[l] -= vx2*back;
+				b.y[l] -= vy2*back;
+				a.dir[l] = pick(touch & live[l], new_a, da);
+				b.dir[l] = pick(touch & live[l], new_b, db);
+			}
+			store(j, b);
+		}
+
+		//INTRODUCE MOVEMENT RANDOMNESS PERIODICALLY
+		//(after this sheep's bounces, which it overrides)
+		float *last = switched_at.data() + lane(first, i);
+		for(uint32_t l=0;l<BATCH_LANES;l++){
+			//(as World, where the switches wheel hands a sheep out once its deadline's slot comes up,
+			// then again on the first step of each later slot until it is due)
+			int32_t slot = int32_t((last[l] + SHEEP_RESET_TIME) / switch_slot);
+			int32_t looked = (now_slot[l] >= slot) & new_slot[l];
+			int32_t due = live[l] & looked & (now[l] - last[l] > SHEEP_RESET_TIME);
+			int32_t d = int32_t(rng_hash(rng_hash(key[l] ^ i) ^ counter[l]) >> 30); //random_direction()
+			a.dir[l] = due ? d : a.dir[l];
+			last[l] = due ? now[l] : last[l];
+		}
+		store(i, a);
+	}
+
+	for(uint32_t l=0;l<BATCH_LANES;l++){
+		uint32_t k = first + l;
+		speed[k] += dt[l]*SPEEDUP; //sheep speed increases over time
+		game_over[k] |= uint8_t(hit[l] & live[l]);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+/*
+ * BatchWorld steps thousands of small, independent sheep games at once -- e.g. to score a dog
+ * policy over many seeds, or to tune game parameters -- faster than a World per game would.
+ *
+ * Game k's sheep live in lane k: per-sheep arrays are laid out sheep-major, so sheep s of
+ * BATCH_LANES neighbouring games sit side by side in memory, and each rule runs on a whole
+ * block of games with the same branch-free instructions (which the compiler vectorizes).
+ *
+ * Every game follows World::step's rules for one dog (ordered contacts, no herding) and lands
+ * on exactly the same state as a World with the same sheep count and seed, as long as steps
+ * are short enough that World would not sweep -- there are no swept tests here, so keep steps
+ * short (as FixedStep does). Games all share one set of obstacles. Sheep/sheep contacts test
+ * every pair, so this is for SHEEP_COUNT-sized flocks; big flocks want World's broadphase.
+ *
+ * A game that ends stays as it ended (step_all() leaves it alone, with game_over[k] set)
+ * until it is reset().
+ *
+ * Example:
+ *   BatchWorld batch(4096, SHEEP_COUNT, seed); //game k starts from seed + k
+ *   std::vector< glm::vec2 > dogs(batch.games);
+ *   for (...) {
+ *     dogs[k] = ...; //every game's dog
+ *     batch.step_all(1.0f / 120.0f, dogs.data());
+ *     if (batch.game_over[k]) { score(batch.total_time[k]); batch.reset(k, new_seed); }
+ *   }
+ */
+
+#include "World.hpp"
+#include "Obstacles.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#define BATCH_LANES 8 //games stepped together (at least the widest SIMD width, in floats)
+#define BATCH_GRAIN 64 //blocks of BATCH_LANES games per parallel chunk
+
+struct BatchWorld {
+	//'games' games of 'sheep' sheep, game k set up as World(sheep, seed + k):
+	BatchWorld(uint32_t games, int sheep = SHEEP_COUNT, uint32_t seed = 0);
+
+	//advance every running game by 'elapsed' seconds, with game k's dog moved to dog_pos[k]:
+	void step_all(float elapsed, glm::vec2 const *dog_pos);
+
+	//start game 'game' over, as World(sheep, seed):
+	void reset(uint32_t game, uint32_t seed);
+
+	//write game 'game' to 'world' (as its only dog), for drawing or to carry on with World:
+	void unpack(uint32_t game, World &world) const;
+
+	//if set, step_all() splits blocks of games across this pool (results are identical either way):
+	ThreadPool *pool = nullptr;
+
+	uint32_t games;
+	uint32_t sheep; //per game
+	float radius; //all sheep in all games are the same size
+	Obstacles obstacles; //shared by every game; starts as World's pen
+
+	//per game:
+	std::vector< uint8_t > game_over; //set once a sheep in the game touches a fence
+	std::vector< float > total_time;
+	std::vector< float > speed;
+	std::vector< uint32_t > seed, tick;
+	std::vector< glm::vec2 > dogs;
+
+	//per sheep per game, sheep s of game k at lane(k, s):
+	std::vector< float > x, y;
+	std::vector< float > switched_at;
+	std::vector< uint8_t > dir; //Flock::Direction
+	std::vector< uint8_t > dog_touch; //1 if overlapping the dog as of the last step
+	size_t lane(uint32_t game, uint32_t s) const { return size_t(s) * stride + game; }
+	glm::vec2 pos(uint32_t game, uint32_t s) const { return glm::vec2(x[lane(game, s)], y[lane(game, s)]); }
+
+	//----- internals -----
+	uint32_t stride; //games, rounded up to whole blocks (the lanes past 'games' stay over)
+	//how World starts a game:
+	std::vector< float > start_x, start_y;
+	float start_speed;
+	glm::vec2 start_dog;
+	float switch_slot; //World::switches' slot time (times are compared slot by slot, as there)
+	void step_block(uint32_t first, float elapsed); //games [first, first+BATCH_LANES)
+};
@@ -0,0 +1,220 @@
+#include "Collide.hpp"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COLLIDE_X86 1
+#include <immintrin.h>
+#define COLLIDE_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define COLLIDE_X86 1
+#include <immintrin.h>
+#include <intrin.h>
+#define COLLIDE_TARGET_AVX2
+#endif
+
+//all kernels test one group of sixteen sheep against this box; 'width' is the sheep's full width:
+struct Box {
+	float radius, width;
+	glm::vec2 min, max;
+};
+
+static uint16_t scalar_16(float const *x, float const *y, Box const &box) {
+	uint16_t mask = 0;
+	for (uint32_t k = 0; k < 16; ++k) {
+		float l = x[k] - box.radius, b = y[k] - box.radius;
+		bool hit = (l < box.max.x) & (l + box.width > box.min.x) & (b < box.max.y) & (b + box.width > box.min.y);
+		mask |= uint16_t(hit) << k;
+	}
+	return mask;
+}
+
+//...or against this circle; 'radius2' is the squared radius:
+struct Circle {
+	glm::vec2 center;
+	float radius2;
+};
+
+static uint16_t circle_scalar_16(float const *x, float const *y, Circle const &circle) {
+	uint16_t mask = 0;
+	for (uint32_t k = 0; k < 16; ++k) {
+		float dx = x[k] - circle.center.x, dy = y[k] - circle.center.y;
+		bool hit = (dx*dx + dy*dy < circle.radius2);
+		mask |= uint16_t(hit) << k;
+	}
+	return mask;
+}
+
+#ifdef COLLIDE_X86
+static uint16_t sse2_16(float const *x, float const *y, Box const &box) {
+	__m128 radius = _mm_set1_ps(box.radius), width = _mm_set1_ps(box.width);
+	__m128 min_x = _mm_set1_ps(box.min.x), max_x = _mm_set1_ps(box.max.x);
+	__m128 min_y = _mm_set1_ps(box.min.y), max_y = _mm_set1_ps(box.max.y);
+	uint32_t mask = 0;
+	for (uint32_t k = 0; k < 16; k += 4) {
+		__m128 l = _mm_sub_ps(_mm_loadu_ps(x + k), radius);
+		__m128 b = _mm_sub_ps(_mm_loadu_ps(y + k), radius);
+		__m128 hit = _mm_and_ps(
+			_mm_and_ps(_mm_cmplt_ps(l, max_x), _mm_cmpgt_ps(_mm_add_ps(l, width), min_x)),
+			_mm_and_ps(_mm_cmplt_ps(b, max_y), _mm_cmpgt_ps(_mm_add_ps(b, width), min_y))
+		);
+		mask |= uint32_t(_mm_movemask_ps(hit)) << k;
+	}
+	return uint16_t(mask);
+}
+
+COLLIDE_TARGET_AVX2
+static uint16_t avx2_16(float const *x, float const *y, Box const &box) {
+	__m256 radius = _mm256_set1_ps(box.radius), width = _mm256_set1_ps(box.width);
+	__m256 min_x = _mm256_set1_ps(box.min.x), max_x = _mm256_set1_ps(box.max.x);
+	__m256 min_y = _mm256_set1_ps(box.min.y), max_y = _mm256_set1_ps(box.max.y);
+	uint32_t mask = 0;
+	for (uint32_t k = 0; k < 16; k += 8) {
+		__m256 l = _mm256_sub_ps(_mm256_loadu_ps(x + k), radius);
+		__m256 b = _mm256_sub_ps(_mm256_loadu_ps(y + k), radius);
+		__m256 hit = _mm256_and_ps(
+			_mm256_and_ps(_mm256_cmp_ps(l, max_x, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(l, width), min_x, _CMP_GT_OQ)),
+			_mm256_and_ps(_mm256_cmp_ps(b, max_y, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(b, width), min_y, _CMP_GT_OQ))
+		);
+		mask |= uint32_t(_mm256_movemask_ps(hit)) << k;
+	}
+	return uint16_t(mask);
+}
+
+static uint16_t circle_sse2_16(float const *x, float const *y, Circle const &circle) {
+	__m128 cx = _mm_set1_ps(circle.center.x), cy = _mm_set1_ps(circle.center.y), radius2 = _mm_set1_ps(circle.radius2);
+	uint32_t mask = 0;
+	for (uint32_t k = 0; k < 16; k += 4) {
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(x + k), cx);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(y + k), cy);
+		__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		mask |= uint32_t(_mm_movemask_ps(_mm_cmplt_ps(d2, radius2))) << k;
+	}
+	return uint16_t(mask);
+}
+
+COLLIDE_TARGET_AVX2
+static uint16_t circle_avx2_16(float const *x, float const *y, Circle const &circle) {
+	__m256 cx = _mm256_set1_ps(circle.center.x), cy = _mm256_set1_ps(circle.center.y), radius2 = _mm256_set1_ps(circle.radius2);
+	uint32_t mask = 0;
+	for (uint32_t k = 0; k < 16; k += 8) {
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + k), cx);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + k), cy);
+		__m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		mask |= uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(d2, radius2, _CMP_LT_OQ))) << k;
+	}
+	return uint16_t(mask);
+}
+
+static bool cpu_has_avx2() {
+	#if defined(__GNUC__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+	#else
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false; //OS must save ymm registers
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+	#endif
+}
+#endif //COLLIDE_X86
+
+typedef uint16_t (*Kernel16)(float const *, float const *, Box const &);
+typedef uint16_t (*CircleKernel16)(float const *, float const *, Circle const &);
+
+static struct Dispatch {
+	Dispatch() {
+		#ifdef COLLIDE_X86
+		if (cpu_has_avx2()) {
+			kernel = avx2_16;
+			circle = circle_avx2_16;
+			name = "avx2";
+		} else {
+			//every x86 target we build for has SSE2:
+			kernel = sse2_16;
+			circle = circle_sse2_16;
+			name = "sse2";
+		}
+		#endif
+	}
+	Kernel16 kernel = scalar_16;
+	CircleKernel16 circle = circle_scalar_16;
+	char const *name = "scalar";
+} dispatch;
+
+void aabb_overlaps(float const *x, float const *y, uint32_t count, float radius,
+	glm::vec2 const &min, glm::vec2 const &max, uint16_t *masks) {
+	Box box;
+	box.radius = radius;
+	box.width = 2*radius;
+	box.min = min;
+	box.max = max;
+
+	Kernel16 kernel = dispatch.kernel;
+	uint32_t full = count / 16;
+	for (uint32_t g = 0; g < full; ++g) {
+		masks[g] = kernel(x + 16*g, y + 16*g, box);
+	}
+	if (count % 16) {
+		//copy the ragged end into a padded group of far-away sheep:
+		float tail_x[16], tail_y[16];
+		for (uint32_t k = 0; k < 16; ++k) {
+			uint32_t i = 16*full + k;
+			tail_x[k] = (i < count ? x[i] : 1e30f);
+			tail_y[k] = (i < count ? y[i] : 1e30f);
+		}
+		masks[full] = kernel(tail_x, tail_y, box);
+	}
+}
+
+void circle_overlaps(float const *x, float const *y, uint32_t count,
+	glm::vec2 const &center, float radius, uint16_t *masks) {
+	Circle circle;
+	circle.center = center;
+	circle.radius2 = radius*radius;
+
+	CircleKernel16 kernel = dispatch.circle;
+	uint32_t full = count / 16;
+	for (uint32_t g = 0; g < full; ++g) {
+		masks[g] = kernel(x + 16*g, y + 16*g, circle);
+	}
+	if (count % 16) {
+		//copy the ragged end into a padded group of far-away points:
+		float tail_x[16], tail_y[16];
+		for (uint32_t k = 0; k < 16; ++k) {
+			uint32_t i = 16*full + k;
+			tail_x[k] = (i < count ? x[i] : 1e30f);
+			tail_y[k] = (i < count ? y[i] : 1e30f);
+		}
+		masks[full] = kernel(tail_x, tail_y, circle);
+	}
+}
+
+bool sweep_overlaps(glm::vec2 const &from, glm::vec2 const &to, glm::vec2 const &half,
+	glm::vec2 const &min, glm::vec2 const &max) {
+	//slab test: shrink the moving box to a point and grow the target by 'half' instead,
+	// then clip the segment's [0,1] time range against each axis's open interval:
+	float enter = 0.0f, leave = 1.0f;
+	for (int a = 0; a < 2; ++a) {
+		float lo = min[a] - half[a], hi = max[a] + half[a];
+		float p = from[a], d = to[a] - from[a];
+		if (d == 0.0f) {
+			if (!(p > lo && p < hi)) return false;
+			continue;
+		}
+		float t0 = (lo - p) / d, t1 = (hi - p) / d;
+		if (t0 > t1) std::swap(t0, t1);
+		enter = std::max(enter, t0);
+		leave = std::min(leave, t1);
+		if (enter >= leave) return false;
+	}
+	return true;
+}
+
+char const *aabb_kernel_name() {
+	return dispatch.name;
+}
@@ -0,0 +1,35 @@
+#pragma once
+/*
+ * Collide holds batched box-overlap kernels for testing many sheep against one box.
+ *
+ * Sheep i is the box [x[i]-radius, x[i]+radius] x [y[i]-radius, y[i]+radius]. Kernels test
+ * sixteen sheep per mask using SSE2 or AVX2 when the CPU has them (picked once, at first
+ * use) and plain C++ otherwise; all paths do the same float comparisons as Flock::collision.
+ * circle_overlaps() does the same for distance tests (e.g. neighbour queries), on sheep centers.
+ *
+ * Example:
+ *   std::vector< uint16_t > masks((flock.size() + 15) / 16);
+ *   aabb_overlaps(flock.x.data(), flock.y.data(), flock.size(), radius, box_min, box_max, masks.data());
+ *   bool hit_7 = (masks[7 / 16] >> (7 % 16)) & 1;
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+//set bit (i%16) of masks[i/16] when sheep i overlaps [min,max] (bits past 'count' are zero):
+void aabb_overlaps(float const *x, float const *y, uint32_t count, float radius,
+	glm::vec2 const &min, glm::vec2 const &max, uint16_t *masks);
+
+//set bit (i%16) of masks[i/16] when point (x[i],y[i]) is closer than 'radius' to 'center'
+// (dx*dx + dy*dy < radius*radius, in that order on every path; bits past 'count' are zero):
+void circle_overlaps(float const *x, float const *y, uint32_t count,
+	glm::vec2 const &center, float radius, uint16_t *masks);
+
+//does a box of half-size 'half' moving in a straight line from 'from' to 'to' overlap [min,max] at any point?
+//(for sweeping past boxes that a single overlap test at 'to' would miss):
+bool sweep_overlaps(glm::vec2 const &from, glm::vec2 const &to, glm::vec2 const &half,
+	glm::vec2 const &min, glm::vec2 const &max);
+
+//name of the kernel aabb_overlaps() dispatches to ("avx2", "sse2", or "scalar"):
+char const *aabb_kernel_name();
@@ -1,47 +1,382 @@
 #include "Draw.hpp"
 #include "GL.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <new>
 #include <string>
 #include <stdexcept>
+#include <vector>
+
+#define DRAW_FORMATS 3
+//bytes per instance, by Draw::Format:
+static uint32_t const format_size[DRAW_FORMATS] = {
+	sizeof(Draw::Instance), sizeof(Draw::ShortInstance), sizeof(Draw::PaletteInstance)
+};
+#define DRAW_SEGMENT_BYTES uint32_t(sizeof(Draw::Instance) * DRAW_SEGMENT_INSTANCES)
+
+//command sort keys, most significant first:
+// depth (8 bits), program (8), blend (8), texture (16), format (8), retained (8), unused (8)
+//(nothing is textured yet, so texture is always zero; it sits with the other state, above the
+// vertex format, so textured things will group by texture before format)
+#define KEY_DEPTH 56
+#define KEY_PROGRAM 48
+#define KEY_BLEND 40
+#define KEY_TEXTURE 24
+#define KEY_FORMAT 16
+#define KEY_RETAINED 8 //set for layers, so they don't merge with rectangles
+static uint64_t make_key(uint8_t depth, Draw::Format format, Draw::Blend blend, bool retained) {
+	uint64_t program = (format == Draw::Palette ? 1 : 0); //(Float and Short share a program)
+	return (uint64_t(depth) << KEY_DEPTH) | (program << KEY_PROGRAM) | (uint64_t(blend) << KEY_BLEND)
+		| (uint64_t(format) << KEY_FORMAT) | (uint64_t(retained) << KEY_RETAINED);
+}
+static uint32_t key_field(uint64_t key, uint32_t shift) { return uint32_t(key >> shift) & 0xff; }
+
+//[-1,1] as a normalized short (anything outside is off screen anyway, so clamping doesn't change what's drawn):
+static int16_t to_short(float v) {
+	return int16_t(std::round(std::min(1.0f, std::max(-1.0f, v)) * 32767.0f));
+}
+
+bool Draw::palette_index(glm::u8vec4 const &color, uint8_t *index) {
+	uint32_t packed = uint32_t(color.x) | (uint32_t(color.y) << 8) | (uint32_t(color.z) << 16) | (uint32_t(color.w) << 24);
+	if (!palette.empty() && palette[palette_last] == packed) {
+		*index = palette_last;
+		return true;
+	}
+	uint32_t i = uint32_t(std::find(palette.begin(), palette.end(), packed) - palette.begin());
+	if (i == palette.size()) {
+		if (palette.size() == DRAW_PALETTE_SIZE) return false;
+		palette.emplace_back(packed);
+	}
+	palette_last = uint8_t(i);
+	*index = palette_last;
+	return true;
+}
+
+Draw::Run &Draw::run(uint64_t key) {
+	//(rectangles tend to come in streaks with the same settings, and there are only a few settings in a frame)
+	if (last_run >= runs.size() || runs[last_run].key != key) {
+		last_run = 0;
+		while (last_run < runs.size() && runs[last_run].key != key) ++last_run;
+		if (last_run == runs.size()) runs.emplace_back(Run{ key, std::vector< uint8_t >() });
+	}
+	Run &r = runs[last_run];
+	if (r.instances.empty()) commands.emplace_back(Command{ key, last_run }); //(first rectangle with this key this frame)
+	return r;
+}
 
 void Draw::add_rectangle(glm::vec2 const &min, glm::vec2 const &max, glm::u8vec4 const &color) {
-	//split rectangle into two triangles, and add both to vertex list:
+	//one instance per rectangle (the vertex shader makes the corners), written in its format onto the end of the run
+	// for its settings now, and copied into the ring a run at a time by draw():
+	Format as = format;
+	uint8_t index = 0;
+	if (as == Palette && !palette_index(color, &index)) as = Short; //(no room left in this frame's palette: send the color itself)
+	std::vector< uint8_t > &instances = run(make_key(depth, as, blend, false)).instances;
+	uint32_t at = uint32_t(instances.size());
+	instances.resize(at + format_size[as]);
+	void *out = instances.data() + at;
+	if (as == Float) {
+		new (out) Instance(min, max, color);
+		return;
+	}
+	int16_t box[4] = { to_short(min.x), to_short(min.y), to_short(max.x), to_short(max.y) };
+	if (as == Short) {
+		ShortInstance *inst = reinterpret_cast< ShortInstance * >(out);
+		std::copy(box, box + 4, inst->box);
+		inst->c = color;
+	} else {
+		PaletteInstance *inst = reinterpret_cast< PaletteInstance * >(out);
+		std::copy(box, box + 4, inst->box);
+		inst->index = index;
+		inst->pad = 0;
+	}
+}
+
+void Draw::add_layer(DrawLayer &layer) {
+	commands.emplace_back(Command{ make_key(depth, Float, blend, true), uint32_t(layers.size()) });
+	layers.emplace_back(&layer);
+}
 
-	vertices.emplace_back(glm::vec2(min.x, min.y), color);
-	vertices.emplace_back(glm::vec2(max.x, min.y), color);
-	vertices.emplace_back(glm::vec2(max.x, max.y), color);
+void DrawLayer::add_rectangle(glm::vec2 const &min, glm::vec2 const &max, glm::u8vec4 const &color) {
+	instances.emplace_back(min, max, color);
+	dirty = true;
+}
 
-	vertices.emplace_back(glm::vec2(min.x, min.y), color);
-	vertices.emplace_back(glm::vec2(max.x, max.y), color);
-	vertices.emplace_back(glm::vec2(min.x, max.y), color);
+void DrawLayer::clear() {
+	instances.clear();
+	dirty = true;
+}
+
+void DrawLayer::invalidate() {
+	dirty = true;
+}
+
+void DrawLayer::release() {
+	if (vao) glDeleteVertexArrays(1, &vao);
+	if (buffer) glDeleteBuffers(1, &buffer);
+	vao = buffer = 0;
+	dirty = true;
+}
+
+DrawLayer::~DrawLayer() {
+	release();
 }
 
 static GLuint compile_shader(GLenum type, std::string const &source);
 
+typedef Draw::Command Command;
+
+//one draw call's worth of the ring (or a layer), waiting for its segment to be unmapped:
+struct DrawBatch {
+	uint64_t key;
+	uint32_t offset, count; //bytes into the segment, instances
+	DrawLayer *layer; //if drawing a layer instead
+};
+
+//the ring (see Draw.hpp); shared by every Draw, since the GL objects it streams through are:
+static struct {
+	uint32_t segment = 0; //segment being written (or next to be)
+	uint8_t *mapped = nullptr; //its memory, while mapped
+	uint32_t used = 0; //bytes written to it
+	std::vector< DrawBatch > batches; //to draw, in order, once it is unmapped
+	uint32_t segments = 0; //in the buffer (see Draw.hpp for how many)
+	std::vector< GLsync > fences; //per-segment: the GPU is done with it once this signals
+} ring;
+
+//the programs, buffer, and VAOs, made the first time they are asked for (leaves the buffer bound):
+struct DrawState {
+	GLuint programs[2]; //by the key's program: colored, palette
+	GLint palette_colors; //uniform location in the palette program
+	GLuint buffer;
+	GLuint vaos[DRAW_FORMATS]; //by format (attributes are pointed at each batch as it is drawn)
+};
+static DrawState const &draw_state();
+
+//copy a run of instances that share 'key' into the ring, as one batch per segment they land in:
+static void stream(uint64_t key, std::vector< uint8_t > const &instances);
+
+//draw the batches waiting (unmapping the segment first, and fencing and moving past it after, if it was mapped):
+static void flush();
+
+//make room in the ring for DRAW_RING_FRAMES frames of 'frame_segments' segments (call with nothing mapped):
+static void reserve_ring(uint32_t frame_segments);
+
+//sort commands by key, keeping the order they were added among equal keys:
+static void radix_sort(std::vector< Command > *commands);
+
 void Draw::draw() {
-	//draw() uses a very simple vertex and fragment shader, which is compiled the first time the draw() function is called.
+	//this frame's palette (the palette program is only used by this draw() until the next one sends its own):
+	if (!palette.empty()) {
+		DrawState const &state = draw_state();
+		glUseProgram(state.programs[1]);
+		glUniform1uiv(state.palette_colors, GLsizei(palette.size()), palette.data());
+	}
+
+	//segments this frame fills (a run can leave up to an instance, plus alignment, unused at the end of each one):
+	uint64_t bytes = 0;
+	for (Command const &command : commands) {
+		if (!key_field(command.key, KEY_RETAINED)) bytes += runs[command.index].instances.size() + 3;
+	}
+	reserve_ring(uint32_t(bytes / (DRAW_SEGMENT_BYTES - sizeof(Instance) - 3)) + 1);
+
+	radix_sort(&commands);
+	for (Command const &command : commands) {
+		if (key_field(command.key, KEY_RETAINED)) {
+			ring.batches.emplace_back(DrawBatch{ command.key, 0, 0, layers[command.index] });
+		} else {
+			stream(command.key, runs[command.index].instances);
+		}
+	}
+	flush();
+
+	//settings used this frame will likely be used next frame, so keep their runs (and the memory) around:
+	runs.erase(std::remove_if(runs.begin(), runs.end(), [](Run const &r) { return r.instances.empty(); }), runs.end());
+	for (Run &r : runs) r.instances.clear();
+	commands.clear();
+	layers.clear();
+	palette.clear();
+}
+
+static void radix_sort(std::vector< Command > *commands) {
+	//least significant byte first (each pass is stable), skipping bytes every key has the same value in:
+	static std::vector< Command > temp;
+	uint32_t count = uint32_t(commands->size());
+	if (count < 2) return;
+	uint32_t counts[8][256] = { };
+	for (Command const &c : *commands) {
+		for (uint32_t b = 0; b < 8; ++b) counts[b][(c.key >> (8 * b)) & 0xff] += 1;
+	}
+	temp.resize(count);
+	for (uint32_t b = 0; b < 8; ++b) {
+		if (counts[b][((*commands)[0].key >> (8 * b)) & 0xff] == count) continue;
+		uint32_t starts[256];
+		uint32_t total = 0;
+		for (uint32_t v = 0; v < 256; ++v) {
+			starts[v] = total;
+			total += counts[b][v];
+		}
+		for (Command const &c : *commands) {
+			temp[starts[(c.key >> (8 * b)) & 0xff]++] = c;
+		}
+		commands->swap(temp);
+	}
+}
+
+static void stream(uint64_t key, std::vector< uint8_t > const &instances) {
+	uint32_t size = format_size[key_field(key, KEY_FORMAT)];
+	uint8_t const *begin = instances.data(), *end = instances.data() + instances.size();
+	while (begin != end) {
+		//(batches start on 4-byte boundaries, for the attribute pointers)
+		uint32_t offset = (ring.used + 3) & ~3U;
+		if (ring.mapped && offset + size > DRAW_SEGMENT_BYTES) {
+			flush();
+			offset = 0;
+		}
+		if (!ring.mapped) {
+			draw_state(); //(make sure the buffer exists and is bound)
+
+			//wait until the GPU is through with what was last drawn from this segment:
+			GLsync &fence = ring.fences[ring.segment];
+			if (fence) {
+				while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) { }
+				glDeleteSync(fence);
+				fence = 0;
+			}
+			//...so it can be written without the driver synchronizing (or keeping the old contents):
+			ring.mapped = reinterpret_cast< uint8_t * >(glMapBufferRange(GL_ARRAY_BUFFER,
+				DRAW_SEGMENT_BYTES * ring.segment, DRAW_SEGMENT_BYTES,
+				GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT));
+			if (!ring.mapped) throw std::runtime_error("Failed to map vertex buffer segment.");
+			ring.used = 0;
+			offset = 0;
+		}
+
+		//as many as fit in this segment, in the order they were added:
+		uint32_t count = std::min(uint32_t(end - begin) / size, (DRAW_SEGMENT_BYTES - offset) / size);
+		std::memcpy(ring.mapped + offset, begin, count * size);
+		ring.batches.emplace_back(DrawBatch{ key, offset, count, nullptr });
+		ring.used = offset + count * size;
+		begin += count * size;
+	}
+}
+
+static void reserve_ring(uint32_t frame_segments) {
+	uint32_t want = DRAW_RING_FRAMES * frame_segments;
+	if (want <= ring.segments) return;
+	draw_state(); //(make sure the buffer exists and is bound)
+	//new storage, with every segment free; the old storage is orphaned, so draws still reading it finish from it:
+	glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(DRAW_SEGMENT_BYTES) * want, nullptr, GL_STREAM_DRAW);
+	for (GLsync fence : ring.fences) {
+		if (fence) glDeleteSync(fence);
+	}
+	ring.fences.assign(want, GLsync(0));
+	ring.segments = want;
+	ring.segment = 0;
+}
+
+//point the bound VAO's attributes at instances in 'format' starting 'base' bytes into the bound buffer:
+static void instance_attributes(Draw::Format format, GLbyte *base);
+
+static void flush() {
+	DrawState const &state = draw_state();
+
+	bool streamed = (ring.mapped != nullptr);
+	if (streamed) {
+		//send instances to graphics card (only the part written):
+		glBindBuffer(GL_ARRAY_BUFFER, state.buffer);
+		glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, ring.used);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		ring.mapped = nullptr;
+	}
+
+	//draw a unit quad per instance, a batch at a time, only changing state between batches that differ:
+	GLuint program = 0;
+	uint32_t blend = ~0U;
+	for (DrawBatch const &batch : ring.batches) {
+		GLuint want = state.programs[key_field(batch.key, KEY_PROGRAM)];
+		if (want != program) {
+			program = want;
+			glUseProgram(program);
+		}
+		if (key_field(batch.key, KEY_BLEND) != blend) {
+			blend = key_field(batch.key, KEY_BLEND);
+			if (blend == Draw::Alpha) {
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			} else {
+				glDisable(GL_BLEND);
+			}
+		}
+
+		if (batch.layer) {
+			DrawLayer &layer = *batch.layer;
+			if (!layer.vao) {
+				glGenBuffers(1, &layer.buffer);
+				glGenVertexArrays(1, &layer.vao);
+				glBindVertexArray(layer.vao);
+				glBindBuffer(GL_ARRAY_BUFFER, layer.buffer);
+				instance_attributes(Draw::Float, (GLbyte *)0);
+				layer.dirty = true;
+			}
+			if (layer.dirty) {
+				glBindBuffer(GL_ARRAY_BUFFER, layer.buffer);
+				glBufferData(GL_ARRAY_BUFFER, sizeof(Draw::Instance) * layer.instances.size(), layer.instances.data(), GL_STATIC_DRAW);
+				layer.dirty = false;
+			}
+			if (layer.instances.empty()) continue;
+			glBindVertexArray(layer.vao);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, layer.instances.size());
+		} else {
+			//(GL 3.3 can't start instancing part way into a buffer, so the attributes point at the batch)
+			Draw::Format format = Draw::Format(key_field(batch.key, KEY_FORMAT));
+			glBindVertexArray(state.vaos[format]);
+			glBindBuffer(GL_ARRAY_BUFFER, state.buffer);
+			instance_attributes(format, (GLbyte *)0 + DRAW_SEGMENT_BYTES * ring.segment + batch.offset);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, batch.count);
+		}
+	}
+	ring.batches.clear();
+
+	if (streamed) {
+		//note when the GPU is done with the segment, and move on:
+		ring.fences[ring.segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		ring.segment = (ring.segment + 1) % ring.segments;
+		ring.used = 0;
+	}
+}
+
+static DrawState const &draw_state() {
+	//uses a very simple vertex and fragment shader, which is compiled the first time this is called.
 
 	//----- initialization code -----
 
-	//attribute locations for program:
-	#define program_Position 0
-	#define program_Color 1
-	static GLuint program = [](){
+	//attribute locations for programs:
+	#define program_Min 0
+	#define program_Max 1
+	#define program_Color 2 //(an index in the Palette program)
+
+	//the two programs differ only in where the color comes from:
+	auto make_program = [](char const *color_input, char const *color_value){
 		GLuint program = 0;
 
 		//STR( program_Position ) evaluates to a quoted version of program_Position, i.e., "0"
 		#define STR_( X ) # X
 		#define STR( X ) STR_( X )
 		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER,
-			"#version 330\n"
-			"layout(location = " STR(program_Position) ") in vec4 Position;\n"
-			"layout(location = " STR(program_Color) ") in vec4 Color;\n"
-			"out vec4 color;\n"
-			"void main() {\n"
-			"	gl_Position = Position;\n"
-			"	color = Color;\n"
-			"}\n"
+			std::string("#version 330\n")
+			+ "layout(location = " STR(program_Min) ") in vec2 Min;\n"
+			+ "layout(location = " STR(program_Max) ") in vec2 Max;\n"
+			+ "layout(location = " STR(program_Color) ") in " + color_input + ";\n"
+			+ "uniform uint Palette[" STR(DRAW_PALETTE_SIZE) "];\n"
+			+ "out vec4 color;\n"
+			+ "void main() {\n"
+			//unit quad corner (0,0) (1,0) (0,1) (1,1), as a triangle strip:
+			+ "	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+			+ "	gl_Position = vec4(mix(Min, Max, corner), 0.0, 1.0);\n"
+			+ "	color = " + color_value + ";\n"
+			+ "}\n"
 		);
 
 		GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER,
@@ -74,41 +409,51 @@ void Draw::draw() {
 			throw std::runtime_error("failed to link program");
 		}
 		return program;
-	}();
+	};
 
-	//we also need a buffer and a VAO to reference said buffer:
+	//we also need a buffer (with room for the whole ring) and VAOs to reference said buffer:
+	//(it gets its storage from reserve_ring())
 	static GLuint buffer = [](){
 		GLuint buffer;
 		glGenBuffers(1, &buffer);
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
 		return buffer;
 	}();
 
-	static GLuint vao = [](){
-		GLuint vao;
-		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glVertexAttribPointer(program_Position, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0);
-		glVertexAttribPointer(program_Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLbyte *)0 + sizeof(glm::vec2));
-		glEnableVertexAttribArray(program_Position);
-		glEnableVertexAttribArray(program_Color);
-		return vao;
+	static DrawState state = [&make_program](){
+		DrawState state;
+		state.programs[0] = make_program("vec4 Color", "Color");
+		//(palette colors are packed r | g << 8 | b << 16 | a << 24):
+		state.programs[1] = make_program("uint Color", "vec4((uvec4(Palette[Color]) >> uvec4(0u, 8u, 16u, 24u)) & 0xffu) / 255.0");
+		state.palette_colors = glGetUniformLocation(state.programs[1], "Palette");
+		state.buffer = buffer;
+		glGenVertexArrays(DRAW_FORMATS, state.vaos);
+		return state;
 	}();
 
-	//------ actual drawing ------
-
-	//send vertices to graphics card:
 	glBindBuffer(GL_ARRAY_BUFFER, buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), &vertices[0], GL_STREAM_DRAW);
-
-	//draw vertices:
-	glUseProgram(program);
-	glBindVertexArray(vao);
-	glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+	return state;
+}
 
-	//clear vertex list:
-	vertices.clear();
+static void instance_attributes(Draw::Format format, GLbyte *base) {
+	GLsizei stride = format_size[format];
+	if (format == Draw::Float) {
+		glVertexAttribPointer(program_Min, 2, GL_FLOAT, GL_FALSE, stride, base);
+		glVertexAttribPointer(program_Max, 2, GL_FLOAT, GL_FALSE, stride, base + sizeof(glm::vec2));
+		glVertexAttribPointer(program_Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, base + 2 * sizeof(glm::vec2));
+	} else {
+		//(normalized, so the shader sees the same [-1,1] floats as with Float)
+		glVertexAttribPointer(program_Min, 2, GL_SHORT, GL_TRUE, stride, base);
+		glVertexAttribPointer(program_Max, 2, GL_SHORT, GL_TRUE, stride, base + 2 * sizeof(int16_t));
+		if (format == Draw::Short) {
+			glVertexAttribPointer(program_Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, base + 4 * sizeof(int16_t));
+		} else {
+			glVertexAttribIPointer(program_Color, 1, GL_UNSIGNED_BYTE, stride, base + 4 * sizeof(int16_t));
+		}
+	}
+	for (GLuint attrib : { program_Min, program_Max, program_Color }) {
+		glEnableVertexAttribArray(attrib);
+		glVertexAttribDivisor(attrib, 1); //(advance once per rectangle, not per vertex)
+	}
 }
 
 static GLuint compile_shader(GLenum type, std::string const &source) {
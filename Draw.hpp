@@ -4,32 +4,167 @@
  *
  * All drawing operations use [-1,1] x [-1,1] window coordinates.
  *
+ * Draw is a command list, sorted by a 64-bit key made from the settings at the time something
+ * is added (depth, then program, blend, texture). add_rectangle() appends the rectangle to the
+ * run of rectangles added with the same key, so there is one command per run (and per
+ * add_layer()), however many rectangles there are. draw() radix-sorts the commands by key and
+ * sends each run as one batch, so the GL state changes and draw calls grow with the number of
+ * distinct settings, not with the number of things drawn, or the order they were added in.
+ * Things are drawn in order of depth (lowest first); at the same depth, things with the same
+ * settings are drawn in the order they were added, but may move around things with others.
+ *
+ * The cost of sorting is that each instance is written twice: into its run when it is added,
+ * then copied, a run at a time, into the ring by draw() -- where writing straight into the
+ * ring in the order things were added would write it once.
+ *
+ * Rectangles are drawn instanced: each is a single Instance (corners and color), and the
+ * vertex shader stretches a unit quad over it, so a batch is one glDrawArraysInstanced().
+ *
+ * How instances are stored is picked by 'format' (see Draw::Format): as floats (20 bytes),
+ * or with the corners as normalized shorts -- plenty for [-1,1] at any window size -- and
+ * either the color (12 bytes) or an index into a palette kept by Draw (10 bytes). The palette
+ * starts over every draw(), and holds the first DRAW_PALETTE_SIZE distinct colors of a frame;
+ * rectangles in any color past those are sent as Short instead.
+ *
+ * Instances go to GPU-visible memory: one instance buffer is split into a ring of segments
+ * (DRAW_SEGMENT_INSTANCES rectangles each), and draw() writes the sorted batches into whichever
+ * segment is mapped. A segment that fills up is drawn right away and the next one mapped, so
+ * big frames go out in several pieces (clear before adding rectangles). Each segment is fenced,
+ * and only mapped again once the GPU has finished drawing from it.
+ * The ring is sized by the biggest frame so far: it holds DRAW_RING_FRAMES times the segments
+ * that frame needed. draw() works out what a frame needs before writing any of it, and grows
+ * the ring first if it is short (the old buffer storage is orphaned, not waited on). So a frame
+ * never wraps around onto segments it wrote itself, and the GPU has DRAW_RING_FRAMES - 1 frames
+ * to finish with a segment before it is written again. (E.g., a frame of a million Float
+ * rectangles needs 16 segments, so the ring grows to 48, about 63MB; Palette needs half that.)
+ * The ring is shared by every Draw, so draw() one at a time.
+ *
+ * Geometry that doesn't change from frame to frame can go in a DrawLayer instead: its
+ * rectangles live in a buffer of their own, uploaded the first time the layer is drawn (and
+ * again only after it changes), so drawing it again costs nothing to send.
+ *
  * Example:
  * //draws a red rectangle in the upper right quadrant of the window:
  *   Draw draw;
  *   draw.add_rect(glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 1.0f), glm::u8vec4(0xff, 0x00, 0x00, 0xff));
  *   draw.draw();
+ *
+ * //the same, sending fewer bytes per rectangle:
+ *   Draw draw(Draw::Palette);
+ *   ...
+ *
+ * //draws a layer made once (e.g., at level load), then a moving rectangle on top of it:
+ *   DrawLayer scenery;
+ *   scenery.add_rectangle(glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -0.9f), glm::u8vec4(0xa7, 0x71, 0x50, 0xff));
+ *   ...
+ *   Draw draw;
+ *   draw.add_layer(scenery);
+ *   draw.depth = 1;
+ *   draw.add_rectangle(pos - 0.1f, pos + 0.1f, glm::u8vec4(0xff, 0xff, 0xff, 0xff));
+ *   draw.draw();
  */
 
-#include <vector>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <vector>
+
+#define DRAW_RING_FRAMES 3 //frames' worth of segments in the ring (one being written, the rest drawing)
+#define DRAW_SEGMENT_INSTANCES 65536 //rectangles per segment (of the largest format; more of the others fit)
+#define DRAW_PALETTE_SIZE 256 //most distinct colors a Palette-format Draw sends as indices per frame
+
+struct DrawLayer;
 
 struct Draw {
+	//how rectangles are sent to the GPU:
+	enum Format : uint8_t {
+		Float = 0, //float corners, color (Instance, 20 bytes)
+		Short = 1, //normalized int16 corners, color (ShortInstance, 12 bytes)
+		Palette = 2, //normalized int16 corners, palette index (PaletteInstance, 10 bytes)
+	};
+	//how rectangles are combined with what's already drawn:
+	enum Blend : uint8_t {
+		Opaque = 0, //replace it
+		Alpha = 1, //mix by the rectangle's alpha
+	};
+	Draw(Format format_ = Float) : format(format_) { }
+
+	//settings for whatever is added next (they can change between adds):
+	Format format;
+	uint8_t depth = 0; //drawn in order of depth, lowest first
+	Blend blend = Opaque;
+
 	//add rectangle [min.x,max.x] x [min.y,max.y] in color 'color':
 	void add_rectangle(glm::vec2 const &min, glm::vec2 const &max, glm::u8vec4 const &color);
-	//draw all rectangles added since last call to draw():
+	//add a layer's rectangles, drawn as one (uploading them first if they changed; they are always Float):
+	// (the layer must stay around until draw())
+	void add_layer(DrawLayer &layer);
+	//draw everything added since last call to draw() (so one Draw can be used frame after frame):
 	void draw();
 
 	//----- internals -----
-	//simple class for holding on to position + color attribute:
-	struct Vertex {
-		Vertex(glm::vec2 const &v_, glm::u8vec4 const &c_)
-			: v(v_), c(c_) {
+	//simple class for holding on to per-rectangle attributes:
+	struct Instance {
+		Instance(glm::vec2 const &min_, glm::vec2 const &max_, glm::u8vec4 const &c_)
+			: min(min_), max(max_), c(c_) {
 		}
-		glm::vec2 v;
+		glm::vec2 min, max;
+		glm::u8vec4 c;
+	};
+	static_assert(sizeof(Instance) == 20, "Instance is tightly packed.");
+	struct ShortInstance {
+		int16_t box[4]; //min.x, min.y, max.x, max.y, as [-32767,32767] for [-1,1]
 		glm::u8vec4 c;
 	};
-	static_assert(sizeof(Vertex) == 12, "Vertex is tightly packed.");
-	//list of triangles to draw next call to "draw()":
-	std::vector< Vertex > vertices;
+	static_assert(sizeof(ShortInstance) == 12, "ShortInstance is tightly packed.");
+	struct PaletteInstance {
+		int16_t box[4];
+		uint8_t index; //into the palette
+		uint8_t pad;
+	};
+	static_assert(sizeof(PaletteInstance) == 10, "PaletteInstance is tightly packed.");
+
+	//rectangles added with the same settings, in the order they were added:
+	struct Run {
+		uint64_t key;
+		std::vector< uint8_t > instances; //in the key's format
+	};
+	std::vector< Run > runs; //(kept from frame to frame, emptied by draw())
+	uint32_t last_run = 0; //most recently added to
+	Run &run(uint64_t key); //the run for 'key', queueing a command for it if it's the first this frame
+
+	//one run or layer to draw (see Draw.cpp for the bits of 'key'):
+	struct Command {
+		uint64_t key;
+		uint32_t index; //index in 'runs', or in 'layers'
+	};
+	std::vector< Command > commands;
+	std::vector< DrawLayer * > layers; //added layers
+
+	std::vector< uint32_t > palette; //this frame's colors, as r | g << 8 | b << 16 | a << 24
+	uint8_t palette_last = 0; //most recently looked up (rectangles tend to come in runs of one color)
+	//find (or add) 'color' in the palette; false if it's new and the palette is full:
+	bool palette_index(glm::u8vec4 const &color, uint8_t *index);
+};
+
+//rectangles kept on the GPU between frames (see above):
+struct DrawLayer {
+	DrawLayer() = default;
+	DrawLayer(DrawLayer const &) = delete;
+	DrawLayer &operator=(DrawLayer const &) = delete;
+	~DrawLayer();
+
+	//add rectangle [min.x,max.x] x [min.y,max.y] in color 'color' (uploaded next time the layer is drawn):
+	void add_rectangle(glm::vec2 const &min, glm::vec2 const &max, glm::u8vec4 const &color);
+	//remove every rectangle:
+	void clear();
+	//'instances' was changed directly; upload it again next time the layer is drawn:
+	void invalidate();
+	//free the GPU copy (e.g., before the GL context goes away); drawing the layer again makes a new one:
+	void release();
+
+	std::vector< Draw::Instance > instances;
+
+	//----- internals -----
+	bool dirty = true; //instances changed since they were uploaded
+	uint32_t buffer = 0, vao = 0; //GL names (0 until first drawn)
 };
@@ -0,0 +1,42 @@
+#pragma once
+/*
+ * FixedStep turns variable frame times into a whole number of fixed-size simulation steps.
+ *
+ * Frame time piles up in an accumulator and is paid out in 'tick'-second steps; if a long
+ * frame would need more than 'max_steps' steps, the extra backlog is dropped (the game
+ * slows down instead of spiralling). alpha() is how far into the next step the clock is,
+ * for blending the last two simulated states when drawing.
+ *
+ * Example:
+ *   FixedStep fixed(120.0f);
+ *   for (uint32_t steps = fixed.advance(elapsed); steps; --steps) world.step(fixed.tick, dog);
+ *   draw(mix(previous, current, fixed.alpha()));
+ */
+
+#include <cmath>
+#include <cstdint>
+
+struct FixedStep {
+	explicit FixedStep(float tick_rate = 120.0f, uint32_t max_steps_ = 8)
+		: tick(1.0f / tick_rate), max_steps(max_steps_) {
+	}
+
+	//add 'elapsed' seconds of frame time; returns how many steps to take now:
+	uint32_t advance(float elapsed) {
+		accumulator += elapsed;
+		uint32_t steps = 0;
+		while (accumulator >= tick && steps < max_steps) {
+			accumulator -= tick;
+			steps += 1;
+		}
+		if (accumulator >= tick) accumulator = std::fmod(accumulator, tick); //too far behind; drop the backlog
+		return steps;
+	}
+
+	//fraction of a step accumulated but not yet simulated, in [0,1):
+	float alpha() const { return accumulator / tick; }
+
+	float tick; //seconds per step
+	uint32_t max_steps; //most steps advance() will ask for at once
+	float accumulator = 0.0f; //seconds not yet simulated
+};
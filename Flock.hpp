@@ -0,0 +1,71 @@
+#pragma once
+/*
+ * Flock stores sheep as a structure of arrays, so passes over one field
+ * (e.g. integrating positions) stream through contiguous memory and vectorize.
+ *
+ * Sheep only ever walk north, south, east, or west, so velocity is stored as a
+ * direction code; reversing direction is just flipping the low bit.
+ *
+ * Example:
+ *   Flock flock;
+ *   flock.add(glm::vec2(0.0f, 0.3f), Flock::Right);
+ *   flock.set_pos(0, flock.pos(0) + flock.vel(0) * 0.01f);
+ *   flock.flip(0); //now walking left
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct Flock {
+	enum Direction : uint8_t {
+		Right = 0,
+		Left = 1,
+		Up = 2,
+		Down = 3,
+	};
+	static glm::vec2 direction_vector(uint8_t d) {
+		return glm::vec2(dir_x(d), dir_y(d));
+	}
+	//branch-free per-axis components of direction_vector() (so loops using them vectorize):
+	static float dir_x(uint8_t d) { return float(d == Right) - float(d == Left); }
+	static float dir_y(uint8_t d) { return float(d == Up) - float(d == Down); }
+
+	uint32_t size() const { return uint32_t(x.size()); }
+	void clear() {
+		x.clear(); y.clear(); dir.clear(); switched_at.clear();
+	}
+	void add(glm::vec2 const &pos, uint8_t d) {
+		x.emplace_back(pos.x);
+		y.emplace_back(pos.y);
+		dir.emplace_back(d);
+		switched_at.emplace_back(0.0f);
+	}
+
+	glm::vec2 pos(uint32_t i) const { return glm::vec2(x[i], y[i]); }
+	void set_pos(uint32_t i, glm::vec2 const &p) { x[i] = p.x; y[i] = p.y; }
+	glm::vec2 vel(uint32_t i) const { return direction_vector(dir[i]); }
+	void flip(uint32_t i) { dir[i] ^= 1; }
+
+	//does sheep i's box (half-size 'radius') overlap sheep j's box:
+	bool collision(uint32_t i, uint32_t j, float radius) const {
+		//tl stands for top-left corner
+		glm::vec2 tl1 = pos(i) - glm::vec2(radius,radius),
+		          tl2 = pos(j) - glm::vec2(radius,radius);
+		return tl1.x < tl2.x + 2*radius && tl1.x + 2*radius > tl2.x &&
+		       tl1.y < tl2.y + 2*radius && tl1.y + 2*radius > tl2.y;
+	}
+	//does sheep i's box overlap box [tl2,bl2] (used for dog and fence collision):
+	bool collision(uint32_t i, glm::vec2 const &tl2, glm::vec2 const &bl2, float radius) const {
+		glm::vec2 tl1 = pos(i) - glm::vec2(radius,radius);
+		return tl1.x < bl2.x && tl1.x + 2*radius > tl2.x &&
+		       tl1.y < bl2.y && tl1.y + 2*radius > tl2.y;
+	}
+
+	//hot fields:
+	std::vector< float > x, y;
+	std::vector< uint8_t > dir; //Direction
+	//cold fields:
+	std::vector< float > switched_at; //game time of the last directional switch. Used to add randomness
+};
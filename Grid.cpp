@@ -0,0 +1,40 @@
+#include "Grid.hpp"
+
+#include <algorithm>
+
+//past this many cells per axis, cells just get bigger (still correct, only less selective):
+#define GRID_MAX_CELLS 1024
+
+void Grid::reset(glm::vec2 const &min_, glm::vec2 const &max_, float cell_size) {
+	min = min_;
+	glm::vec2 extent = max_ - min_;
+	float longest = std::max(extent.x, extent.y);
+	cell_size = std::max(cell_size, longest / GRID_MAX_CELLS);
+	inv_cell_size = 1.0f / cell_size;
+	size.x = std::max(1, int(extent.x * inv_cell_size) + 1);
+	size.y = std::max(1, int(extent.y * inv_cell_size) + 1);
+}
+
+glm::ivec2 Grid::coords(glm::vec2 const &p) const {
+	//clamp in float first so far-away points don't overflow the int conversion:
+	float fx = std::min(std::max((p.x - min.x) * inv_cell_size, 0.0f), float(size.x - 1));
+	float fy = std::min(std::max((p.y - min.y) * inv_cell_size, 0.0f), float(size.y - 1));
+	return glm::ivec2(int(fx), int(fy));
+}
+
+void Grid::build(std::vector< uint32_t > const &cells) {
+	//counting sort by cell:
+	starts.assign(size.x * size.y + 1, 0);
+	for (uint32_t c : cells) {
+		starts[c + 1] += 1;
+	}
+	for (uint32_t c = 1; c < starts.size(); ++c) {
+		starts[c] += starts[c - 1];
+	}
+	items.resize(cells.size());
+	std::vector< uint32_t > &next = scratch;
+	next.assign(starts.begin(), starts.end() - 1);
+	for (uint32_t i = 0; i < cells.size(); ++i) {
+		items[next[cells[i]]++] = i;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+/*
+ * Grid is a uniform-grid spatial hash for finding nearby items without testing every pair.
+ *
+ * Items are binned by cell index and counting-sorted, so the items in cell 'c' are
+ * items[starts[c]] ... items[starts[c+1]-1]. Points outside [min,max] land in the edge cells.
+ *
+ * Example:
+ *   Grid grid;
+ *   grid.reset(glm::vec2(-1.0f), glm::vec2(1.0f), 0.2f);
+ *   for (each point p) cells.emplace_back(grid.cell(p));
+ *   grid.build(cells);
+ *   //...then look at grid.items in the 3x3 block of cells around grid.cell(q)
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct Grid {
+	//lay out square cells of (at least) 'cell_size' over [min,max]; caps the cell count per axis:
+	void reset(glm::vec2 const &min, glm::vec2 const &max, float cell_size);
+	//cell coordinates holding point 'p' (clamped to the grid):
+	glm::ivec2 coords(glm::vec2 const &p) const;
+	uint32_t cell(glm::vec2 const &p) const {
+		glm::ivec2 c = coords(p);
+		return c.y * size.x + c.x;
+	}
+	//bin items; item i lives in cell cells[i]:
+	void build(std::vector< uint32_t > const &cells);
+
+	glm::vec2 min;
+	float inv_cell_size = 1.0f;
+	glm::ivec2 size = glm::ivec2(1, 1); //cells per axis
+
+	std::vector< uint32_t > starts; //size.x*size.y+1 offsets into items
+	std::vector< uint32_t > items; //item indices grouped by cell, ascending within a cell
+
+	//----- internals -----
+	std::vector< uint32_t > scratch; //fill cursors for build()
+};
@@ -0,0 +1,140 @@
+#include "InputLog.hpp"
+
+#include "FixedStep.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <math.h> //used for scripted dog paths
+#include <stdexcept>
+
+#define INPUT_LOG_MAGIC "SHEEPLOG"
+#define INPUT_LOG_VERSION 1
+
+//zigzag maps small signed numbers to small unsigned ones (0,-1,1,-2,... -> 0,1,2,3,...):
+static uint32_t zigzag(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+static int32_t unzigzag(uint32_t v) { return int32_t(v >> 1) ^ -int32_t(v & 1); }
+
+//seven bits per byte, high bit set on every byte but the last:
+static void put_varint(std::vector< uint8_t > *out, uint64_t v) {
+	while (v >= 0x80) {
+		out->emplace_back(uint8_t(v | 0x80));
+		v >>= 7;
+	}
+	out->emplace_back(uint8_t(v));
+}
+static uint64_t get_varint(std::vector< uint8_t > const &in, size_t *at) {
+	uint64_t v = 0;
+	for (uint32_t shift = 0; shift < 64; shift += 7) {
+		if (*at >= in.size()) throw std::runtime_error("Input log ends in the middle of a number.");
+		uint8_t b = in[(*at)++];
+		v |= uint64_t(b & 0x7f) << shift;
+		if (!(b & 0x80)) return v;
+	}
+	throw std::runtime_error("Input log has an overlong number.");
+}
+
+void InputLog::record(glm::ivec2 const &mouse, uint32_t toggles) {
+	glm::ivec2 delta = mouse - recorded_mouse;
+	recorded_mouse = mouse;
+	put_varint(&bytes, (uint64_t(zigzag(delta.x)) << 2) | (delta.y != 0 ? 2 : 0) | (toggles ? 1 : 0));
+	if (delta.y != 0) put_varint(&bytes, zigzag(delta.y));
+	if (toggles) put_varint(&bytes, toggles);
+	ticks += 1;
+}
+
+bool InputLog::Reader::next() {
+	if (at >= log.bytes.size()) return false;
+	uint64_t head = get_varint(log.bytes, &at);
+	mouse.x += unzigzag(uint32_t(head >> 2));
+	if (head & 2) mouse.y += unzigzag(uint32_t(get_varint(log.bytes, &at)));
+	toggles = (head & 1) ? uint32_t(get_varint(log.bytes, &at)) : 0;
+	return true;
+}
+
+void InputLog::save(std::string const &path) const {
+	std::vector< uint8_t > out(INPUT_LOG_MAGIC, INPUT_LOG_MAGIC + 8);
+	put_varint(&out, INPUT_LOG_VERSION);
+	uint32_t rate_bits;
+	memcpy(&rate_bits, &tick_rate, sizeof(rate_bits));
+	for (uint64_t v : {uint64_t(seed), uint64_t(sheep), uint64_t(rate_bits), uint64_t(size.x), uint64_t(size.y), uint64_t(scripted_dogs), uint64_t(herding), uint64_t(level.size())}) {
+		put_varint(&out, v);
+	}
+	out.insert(out.end(), level.begin(), level.end());
+	put_varint(&out, ticks);
+	put_varint(&out, fingerprint);
+	put_varint(&out, bytes.size());
+	out.insert(out.end(), bytes.begin(), bytes.end());
+
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast< char const * >(out.data()), out.size());
+	if (!file) throw std::runtime_error("Failed to write input log '" + path + "'.");
+}
+
+void InputLog::load(std::string const &path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) throw std::runtime_error("Failed to open input log '" + path + "'.");
+	std::vector< uint8_t > in((std::istreambuf_iterator< char >(file)), std::istreambuf_iterator< char >());
+	if (in.size() < 8 || memcmp(in.data(), INPUT_LOG_MAGIC, 8) != 0) {
+		throw std::runtime_error("'" + path + "' is not an input log.");
+	}
+	size_t at = 8;
+	if (get_varint(in, &at) != INPUT_LOG_VERSION) throw std::runtime_error("'" + path + "' is from another version of the game.");
+	seed = uint32_t(get_varint(in, &at));
+	sheep = uint32_t(get_varint(in, &at));
+	uint32_t rate_bits = uint32_t(get_varint(in, &at));
+	memcpy(&tick_rate, &rate_bits, sizeof(tick_rate));
+	size.x = uint32_t(get_varint(in, &at));
+	size.y = uint32_t(get_varint(in, &at));
+	scripted_dogs = uint32_t(get_varint(in, &at));
+	herding = (get_varint(in, &at) != 0);
+	uint64_t level_size = get_varint(in, &at);
+	if (level_size > in.size() - at) throw std::runtime_error("'" + path + "' is cut short.");
+	level.assign(in.begin() + at, in.begin() + at + level_size);
+	at += level_size;
+	ticks = uint32_t(get_varint(in, &at));
+	fingerprint = get_varint(in, &at);
+	uint64_t count = get_varint(in, &at);
+	if (count != in.size() - at) throw std::runtime_error("'" + path + "' is cut short.");
+	bytes.assign(in.begin() + at, in.end());
+	recorded_mouse = glm::ivec2(0);
+}
+
+World InputLog::start() const {
+	World world(int(sheep), seed);
+	if (!level.empty()) world.obstacles.load(level);
+	world.herding = herding;
+	return world;
+}
+
+float InputLog::tick() const {
+	return FixedStep(tick_rate).tick;
+}
+
+glm::vec2 InputLog::mouse_position(glm::ivec2 const &mouse) const {
+	return glm::vec2(
+		(mouse.x + 0.5f) / float(size.x) * 2.0f - 1.0f,
+		(mouse.y + 0.5f) / float(size.y) *-2.0f + 1.0f
+	);
+}
+
+void InputLog::dogs(World const &world, glm::ivec2 const &mouse, std::vector< glm::vec2 > *out) const {
+	out->resize(1 + scripted_dogs);
+	(*out)[0] = mouse_position(mouse);
+	for (uint32_t d = 1; d < out->size(); ++d) {
+		//scripted dogs circle the pen, evenly spaced:
+		float angle = world.total_time + 6.2831853f * d / out->size();
+		(*out)[d] = 0.5f * glm::vec2(cosf(angle), sinf(angle));
+	}
+}
+
+uint64_t InputLog::fingerprint_of(World const &world) {
+	//FNV-1a over the snapshot block:
+	WorldState state;
+	world.snapshot(&state);
+	uint8_t const *data = reinterpret_cast< uint8_t const * >(state.block.data());
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < state.bytes(); ++i) {
+		hash = (hash ^ data[i]) * 0x100000001b3ULL;
+	}
+	return hash;
+}
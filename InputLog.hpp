@@ -0,0 +1,82 @@
+#pragma once
+/*
+ * InputLog records a play session -- the settings the game started with, then the mouse
+ * and pause key tick by tick -- compactly enough to keep every session, and plays it back
+ * into a World with no window, as fast as it will step.
+ *
+ * The sim only depends on its seed, settings, and the dogs passed to each step, so a replay
+ * lands on exactly the same state; a fingerprint of the final state is saved too, to check.
+ *
+ * Each tick is the change in mouse position (in whole window pixels) since the last tick,
+ * zigzag- and varint-encoded, so a tick where the mouse held still costs one byte:
+ *   varint (zigzag(dx) << 2 | (dy != 0) << 1 | (pause toggles since the last tick > 0))
+ *   [varint zigzag(dy)] [varint toggles]
+ *
+ * Example:
+ *   InputLog log;
+ *   log.seed = seed; ... //settings
+ *   log.record(mouse, toggles); world.step(tick, ...); //every step
+ *   log.finish(world); log.save("session.log");
+ *
+ *   log.load("session.log"); //later, e.g. ./sim_bench --replay session.log
+ *   World world = log.start();
+ *   InputLog::Reader reader(log);
+ *   while (reader.next()) world.step(log.tick(), ...);
+ */
+
+#include "World.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct InputLog {
+	//settings the session started with:
+	uint32_t seed = 0;
+	uint32_t sheep = SHEEP_COUNT;
+	float tick_rate = 120.0f; //simulation steps per second
+	glm::uvec2 size = glm::uvec2(640, 640); //window size, for turning pixels into positions
+	uint32_t scripted_dogs = 0;
+	bool herding = false;
+	std::string level; //level file loaded, if any
+
+	//encoded ticks:
+	std::vector< uint8_t > bytes;
+	uint32_t ticks = 0;
+	uint64_t fingerprint = 0; //fingerprint_of() the world after the last tick (0 if not finished)
+
+	//append a tick with the mouse at pixel 'mouse' and the pause key pressed 'toggles' times since the last one:
+	void record(glm::ivec2 const &mouse, uint32_t toggles);
+	//note the world's state at the end of the session:
+	void finish(World const &world) { fingerprint = fingerprint_of(world); }
+
+	//read or write a log file; these throw std::runtime_error on failure:
+	void save(std::string const &path) const;
+	void load(std::string const &path);
+
+	//a world set up as the session started (level loaded; throws if it can't be):
+	World start() const;
+	float tick() const;
+
+	//where the mouse was, and the dogs for a step with it there (scripted dogs circle the pen):
+	glm::vec2 mouse_position(glm::ivec2 const &mouse) const;
+	void dogs(World const &world, glm::ivec2 const &mouse, std::vector< glm::vec2 > *out) const;
+
+	//a hash of everything World::step() carries over (see WorldState):
+	static uint64_t fingerprint_of(World const &world);
+
+	//walk the ticks in order:
+	struct Reader {
+		explicit Reader(InputLog const &log_) : log(log_) { }
+		bool next(); //false once out of ticks (throws std::runtime_error on a damaged log)
+		InputLog const &log;
+		size_t at = 0;
+		glm::ivec2 mouse = glm::ivec2(0); //as of the tick just read
+		uint32_t toggles = 0;
+	};
+
+	//----- internals -----
+	glm::ivec2 recorded_mouse = glm::ivec2(0); //mouse as of the last recorded tick
+};
@@ -0,0 +1,291 @@
+#include "Kinetic.hpp"
+
+#include "Rng.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+static double const Never = std::numeric_limits< double >::infinity();
+
+//distance (from 0) at which a point at 'p' moving at 'w' per unit distance first gets strictly inside (lo,hi) for good;
+// [enter,leave) comes back through the pointers, empty (enter >= leave) if it never does:
+static void slab(double p, double w, double lo, double hi, double *enter, double *leave){
+	if(w == 0.0){
+		if(lo < p && p < hi){ *enter = -Never; *leave = Never; }
+		else                { *enter = Never;  *leave = -Never; }
+		return;
+	}
+	double a = (lo - p) / w, b = (hi - p) / w;
+	*enter = std::min(a,b);
+	*leave = std::max(a,b);
+}
+
+//distance until a box at 'p' moving at 'w' starts overlapping the box 'half' around 'q', or Never
+// (also Never if they overlap already -- they get left alone until they separate):
+static double first_contact(double px, double py, double wx, double wy, double qx, double qy, double hx, double hy){
+	double ex, lx, ey, ly;
+	slab(px, wx, qx - hx, qx + hx, &ex, &lx);
+	slab(py, wy, qy - hy, qy + hy, &ey, &ly);
+	double enter = std::max(ex,ey), leave = std::min(lx,ly);
+	if(enter < 0.0 || enter >= leave) return Never;
+	return enter;
+}
+
+Kinetic::Kinetic(World const &world){
+	seed = world.seed;
+	speed0 = world.speed;
+	time0 = world.total_time;
+	time = world.total_time;
+	radius = world.radius;
+	game_over = world.game_over;
+	dog = world.dogs[0];
+
+	obstacles = world.obstacles;
+
+	//cells wide enough that sheep that can meet before either is re-filed are in neighbouring cells (with a hair extra for rounding):
+	horizon = KINETIC_HORIZON * radius;
+	glm::vec2 corner = glm::vec2(FENCE_BOUND+FENCE_RAD,FENCE_BOUND+FENCE_RAD);
+	glm::vec2 lo = (obstacles.boxes.empty() ? -corner : obstacles.min), hi = (obstacles.boxes.empty() ? corner : obstacles.max);
+	grid.reset(lo, hi, float(2.0 * radius + 2.0 * horizon) * 1.001f);
+	filed.assign(grid.size.x * grid.size.y, std::vector< uint32_t >());
+
+	Flock const &flock = world.flock;
+	uint32_t count = flock.size();
+	x.assign(flock.x.begin(), flock.x.end());
+	y.assign(flock.y.begin(), flock.y.end());
+	at.assign(count, 0.0);
+	dir = flock.dir;
+	for(uint64_t pair : world.dog_contacts){
+		if(uint32_t(pair) == 0) dog_collide.emplace_back(uint32_t(pair >> 32));
+	}
+	std::sort(dog_collide.begin(), dog_collide.end());
+	switch_time.resize(count);
+	version.assign(count, 0);
+	switches.assign(count, 0);
+	filed_cell.assign(count, -1U);
+	filed_slot.assign(count, 0);
+	refile_at.assign(count, 0.0);
+
+	//everyone is filed before anyone predicts:
+	for(uint32_t i=0;i<count;i++) file(i);
+	for(uint32_t i=0;i<count;i++){
+		//the stepped game switches on the first step past SHEEP_RESET_TIME:
+		switch_time[i] = std::max(time, double(flock.switched_at[i]) + SHEEP_RESET_TIME);
+		queue.push(Event{Event::Switch, distance(switch_time[i]), i, 0, 0, 0});
+		predict(i);
+	}
+}
+
+double Kinetic::distance(double t) const {
+	double s = t - time0;
+	return speed0 * s + 0.5 * double(SPEEDUP) * s * s;
+}
+
+void Kinetic::catch_up(uint32_t i){
+	double moved = now - at[i];
+	x[i] += Flock::dir_x(dir[i]) * moved;
+	y[i] += Flock::dir_y(dir[i]) * moved;
+	at[i] = now;
+}
+
+void Kinetic::changed(uint32_t i){
+	version[i] += 1;
+	predict(i);
+}
+
+void Kinetic::file(uint32_t i){
+	//(a sheep can't get further than the distance it walks from where it was filed, whichever way it turns)
+	uint32_t cell = grid.cell(glm::vec2(float(x_now(i)), float(y_now(i))));
+	if(cell != filed_cell[i]){
+		if(filed_cell[i] != -1U){
+			std::vector< uint32_t > &from = filed[filed_cell[i]];
+			from[filed_slot[i]] = from.back();
+			filed_slot[from.back()] = filed_slot[i];
+			from.pop_back();
+		}
+		filed_cell[i] = cell;
+		filed_slot[i] = uint32_t(filed[cell].size());
+		filed[cell].emplace_back(i);
+	}
+	refile_at[i] = now + horizon;
+	queue.push(Event{Event::Refile, refile_at[i], i, 0, 0, 0});
+}
+
+void Kinetic::predict(uint32_t i){
+	predict_obstacle(i);
+	predict_contact(i);
+}
+
+void Kinetic::predict_obstacle(uint32_t i){
+	//sheep i is caught up to 'now' by the caller (or hasn't moved yet):
+	double wx = Flock::dir_x(dir[i]), wy = Flock::dir_y(dir[i]);
+
+	//next obstacle it walks into, out of the ones in the strip ahead of it (fences only matter until the game ends):
+	{
+		glm::vec2 at = glm::vec2(float(x[i]), float(y[i])), ahead = glm::vec2(float(wx), float(wy));
+		glm::vec2 reach = glm::vec2(float(radius), float(radius));
+		glm::vec2 far = at + ahead * 2.0f * glm::max(obstacles.max - obstacles.min, glm::vec2(1.0f));
+		near.clear();
+		obstacles.query(glm::min(at, far) - reach, glm::max(at, far) + reach, &near);
+		double best = Never;
+		uint32_t hit = 0;
+		for(uint32_t b : near){
+			Obstacles::Box const &box = obstacles.boxes[b];
+			if(game_over && box.kind == Obstacles::Fence) continue;
+			glm::vec2 center = 0.5f * (box.min + box.max), half = 0.5f * (box.max - box.min);
+			double d = first_contact(x[i], y[i], wx, wy, center.x, center.y, half.x + radius, half.y + radius);
+			if(d < best){
+				best = d;
+				hit = b;
+			}
+		}
+		if(best != Never) queue.push(Event{Event::Obstacle, now + best, i, hit, version[i], 0});
+	}
+}
+
+void Kinetic::predict_contact(uint32_t i){
+	//next sheep it meets (whichever changes course first re-predicts, so only the earliest matters).
+	//anyone it can meet before it is next re-filed is filed in the 3x3 cells around it:
+	double px = x_now(i), py = y_now(i);
+	double wx = Flock::dir_x(dir[i]), wy = Flock::dir_y(dir[i]);
+	double best = Never;
+	uint32_t partner = 0;
+	int cx = filed_cell[i] % grid.size.x, cy = filed_cell[i] / grid.size.x;
+	for(int gy=std::max(cy-1,0);gy<=std::min(cy+1,grid.size.y-1);gy++){
+		for(int gx=std::max(cx-1,0);gx<=std::min(cx+1,grid.size.x-1);gx++){
+			for(uint32_t j : filed[gy*grid.size.x+gx]){
+				if(j == i) continue;
+				double d = first_contact(px, py, wx - Flock::dir_x(dir[j]), wy - Flock::dir_y(dir[j]), x_now(j), y_now(j), 2.0 * radius, 2.0 * radius);
+				if(d < best || (d == best && j < partner)){ //(ties go to the lowest index, whatever order cells are visited in)
+					best = d;
+					partner = j;
+				}
+			}
+		}
+	}
+	//(meetings after the re-filing are looked for then)
+	if(best != Never && now + best <= refile_at[i]) queue.push(Event{Event::Contact, now + best, i, partner, version[i], version[partner]});
+}
+
+void Kinetic::advance(float elapsed, glm::vec2 const &dog_pos){
+	double end_time = time + elapsed;
+	double end = distance(end_time);
+
+	while(!queue.empty() && queue.top().d <= end){
+		Event e = queue.top();
+		queue.pop();
+		uint32_t i = e.i;
+
+		if(e.type == Event::Switch){
+			if(e.version_i != switches[i]) continue;
+			now = std::max(now, e.d);
+			catch_up(i);
+			dir[i] = random_direction(seed, i, ~switches[i]); //(counting down from the top, away from World's ticks)
+			switches[i] += 1;
+			switch_time[i] += SHEEP_RESET_TIME;
+			queue.push(Event{Event::Switch, distance(switch_time[i]), i, 0, switches[i], 0});
+			changed(i);
+			events += 1;
+			continue;
+		}
+
+		if(e.type == Event::Refile){
+			if(e.d != refile_at[i]) continue;
+			//(its course hasn't changed, so everything already queued for it still stands)
+			now = std::max(now, e.d);
+			file(i);
+			predict_contact(i);
+			continue;
+		}
+
+		if(e.version_i != version[i]) continue; //i re-predicted since
+		now = std::max(now, e.d);
+		if(e.type == Event::Obstacle){
+			catch_up(i);
+			if(obstacles.boxes[e.j].kind == Obstacles::Fence){
+				//the first fence hit ends the game, and from then on fences are walked through (as predict() ignores them),
+				// so this sheep -- and any other whose fence hit was queued before the game ended -- looks again past it:
+				game_over = true;
+				changed(i);
+			}else{ //Rock: turn around
+				dir[i] ^= 1;
+				changed(i);
+			}
+			events += 1;
+			continue;
+		}
+
+		uint32_t j = e.j;
+		catch_up(i);
+		if(e.version_j != version[j]){ //partner changed course; i's earliest contact may be someone else now
+			predict(i);
+			continue;
+		}
+		catch_up(j);
+
+		//same rules as the stepped bounce, but at the moment of contact:
+		if(dir[i] == (dir[j] ^ 1)){ //direct collision
+			dir[i] ^= 1;
+			dir[j] ^= 1;
+		}else{ //t-bone: whoever reaches the crossing first gets rammed
+			double dist_x = fabs(x[j] - x[i]), dist_y = fabs(y[j] - y[i]);
+			bool i_moves_y = Flock::dir_x(dir[i]) == 0.0f;
+			double distance_i = i_moves_y ? dist_y : dist_x, distance_j = i_moves_y ? dist_x : dist_y;
+			if(distance_i <= distance_j){ //j rams i
+				dir[i] = dir[j];
+				dir[j] ^= 1;
+			}else{ //i rams j
+				dir[j] = dir[i];
+				dir[i] ^= 1;
+			}
+		}
+		changed(i);
+		changed(j);
+		events += 1;
+	}
+
+	now = end;
+	time = end_time;
+
+	//dog: same edge-triggered overlap test as a step, at the end of the interval.
+	//only sheep filed within reach + horizon of the dog can touch it (everyone is within horizon of where they were filed):
+	dog = dog_pos;
+	double reach = (1.0 + double(DOG_SCALE)) * radius;
+	glm::vec2 around = glm::vec2(float(reach + horizon));
+	glm::ivec2 lo = grid.coords(dog - around), hi = grid.coords(dog + around);
+	dog_touching.clear();
+	for(int gy=lo.y;gy<=hi.y;gy++){
+		for(int gx=lo.x;gx<=hi.x;gx++){
+			for(uint32_t i : filed[gy*grid.size.x+gx]){
+				if(fabs(x_now(i) - dog.x) < reach && fabs(y_now(i) - dog.y) < reach) dog_touching.emplace_back(i);
+			}
+		}
+	}
+	std::sort(dog_touching.begin(), dog_touching.end());
+	for(uint32_t i : dog_touching){
+		if(std::binary_search(dog_collide.begin(), dog_collide.end(), i)) continue; //(still touching from before)
+		catch_up(i);
+		dir[i] ^= 1;
+		changed(i);
+	}
+	dog_collide.swap(dog_touching);
+}
+
+void Kinetic::sync(World &world) const {
+	Flock &flock = world.flock;
+	for(uint32_t i=0;i<x.size();i++){
+		double moved = now - at[i];
+		flock.x[i] = float(x[i] + Flock::dir_x(dir[i]) * moved);
+		flock.y[i] = float(y[i] + Flock::dir_y(dir[i]) * moved);
+		flock.dir[i] = dir[i];
+		flock.switched_at[i] = float(switch_time[i] - SHEEP_RESET_TIME);
+	}
+	world.speed = float(speed0 + double(SPEEDUP) * (time - time0));
+	world.total_time = float(time);
+	world.game_over = game_over;
+	world.dogs.assign(1, dog);
+	world.dog_contacts.clear();
+	for(uint32_t i : dog_collide) world.dog_contacts.emplace_back(World::dog_contact(i, 0));
+	world.reschedule();
+}
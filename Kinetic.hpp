@@ -0,0 +1,94 @@
+#pragma once
+/*
+ * Kinetic runs the sheep game event-to-event instead of step-by-step.
+ *
+ * All sheep walk NSEW at one shared speed, so between events each sheep's position is a
+ * straight line in 'distance walked so far' (D). The next fence or rock hit, sheep/sheep contact and
+ * direction switch can all be solved for exactly; they wait in a priority queue, and only
+ * the predictions involving a sheep that changed direction are thrown away and redone.
+ * Sheep are filed in a grid by where they stood at most KINETIC_HORIZON radii of walking ago,
+ * and re-filed once they have walked that far, so a prediction only looks at sheep in the
+ * neighbouring cells, and only that far ahead.
+ * The first fence hit ends the game; after that, sheep walk through fences (each sheep that hits one re-predicts).
+ * The dog is not predictable, so it is checked once per advance() call, like a step, against
+ * the sheep filed near it.
+ * Only the world's first dog is followed.
+ *
+ * A sparse flock costs next to nothing between events, and fast-forwarding with a far-away
+ * dog is one call. Sheep that start out overlapping are left alone until they separate.
+ *
+ * Example:
+ *   World world;
+ *   Kinetic kinetic(world); //take over the world's sheep
+ *   kinetic.advance(60.0f, far_away); //a minute, at the cost of its events
+ *   kinetic.sync(world); //copy the result back for drawing
+ */
+
+#include "World.hpp"
+#include "Grid.hpp"
+
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+#define KINETIC_HORIZON 4.0 //radii walked between re-filings (longer: fewer re-filings, more sheep per cell)
+
+struct Kinetic {
+	explicit Kinetic(World const &world);
+
+	//advance 'elapsed' seconds, then move the dog to 'dog_pos' (flipping any sheep it newly touches):
+	void advance(float elapsed, glm::vec2 const &dog_pos);
+
+	//copy sheep, speed, time, game-over, and the dog (as the world's only dog) back into 'world':
+	void sync(World &world) const;
+
+	//game state:
+	double time = 0.0; //seconds since the World's time zero
+	bool game_over = false;
+	glm::vec2 dog;
+	uint64_t events = 0; //events handled so far (for benchmarking)
+
+	//----- internals -----
+	uint32_t seed; //switch directions are keyed on each sheep's switch count (there are no ticks)
+	//shared speed grows linearly, so distance walked is quadratic in time:
+	double speed0, time0, radius;
+	double distance(double t) const; //distance walked between time0 and 't'
+	double now = 0.0; //distance(time)
+
+	//per-sheep state, as of distance 'at[i]':
+	std::vector< double > x, y, at;
+	std::vector< uint8_t > dir; //Flock::Direction
+	std::vector< uint32_t > dog_collide; //sheep touching the dog as of the last advance(), ascending
+	std::vector< double > switch_time; //when the next random direction switch happens
+	std::vector< uint32_t > version; //bumped whenever a sheep changes course; stale events carry old versions
+	std::vector< uint32_t > switches; //number of switches so far (checks switch events)
+
+	struct Event {
+		enum Type : uint8_t { Contact, Obstacle, Switch, Refile } type;
+		double d; //distance at which it happens
+		uint32_t i, j; //sheep (j is the other sheep for Contact, the box for Obstacle)
+		uint32_t version_i, version_j; //(for Switch, version_i is a switch count; Refile checks 'd' against refile_at)
+		bool operator<(Event const &o) const { return d > o.d; } //earliest on top
+	};
+	std::priority_queue< Event > queue;
+
+	Obstacles obstacles;
+	std::vector< uint32_t > near; //predict() scratch
+	std::vector< uint32_t > dog_touching; //advance() scratch
+
+	//sheep filed by where they were (sheep within 2*radius + 2*horizon of each other are in neighbouring cells):
+	Grid grid;
+	double horizon; //distance walked between re-filings
+	std::vector< std::vector< uint32_t > > filed; //per-cell sheep
+	std::vector< uint32_t > filed_cell, filed_slot; //per-sheep cell, and index in that cell's list
+	std::vector< double > refile_at; //per-sheep distance of its next re-filing
+
+	double x_now(uint32_t i) const { return x[i] + Flock::dir_x(dir[i]) * (now - at[i]); }
+	double y_now(uint32_t i) const { return y[i] + Flock::dir_y(dir[i]) * (now - at[i]); }
+	void catch_up(uint32_t i); //move sheep i's state forward to 'now'
+	void changed(uint32_t i); //sheep i changed direction: invalidate and re-predict
+	void predict(uint32_t i); //queue sheep i's next contact and obstacle hit
+	void predict_obstacle(uint32_t i);
+	void predict_contact(uint32_t i); //(only before sheep i's next re-filing)
+	void file(uint32_t i); //file sheep i where it is now, and queue its next re-filing
+};
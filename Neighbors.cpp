@@ -0,0 +1,83 @@
+#include "Neighbors.hpp"
+
+#include "Collide.hpp"
+
+#include <algorithm>
+
+#define NEIGHBORS_BATCH 256 //points per circle_overlaps() call (keep a multiple of 16)
+
+void Neighbors::build(float const *px, float const *py, uint32_t count, glm::vec2 const &min, glm::vec2 const &max, float range) {
+	grid.reset(min, max, range);
+	cells.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		cells[i] = grid.cell(glm::vec2(px[i], py[i]));
+	}
+	grid.build(cells);
+	x.assign(count + NEIGHBORS_PAD, 1e30f);
+	y.assign(count + NEIGHBORS_PAD, 1e30f);
+	for (uint32_t k = 0; k < count; ++k) {
+		x[k] = px[grid.items[k]];
+		y[k] = py[grid.items[k]];
+	}
+}
+
+void Neighbors::within(glm::vec2 const &p, float radius, std::vector< uint32_t > *out) const {
+	if (grid.items.empty()) return;
+	glm::ivec2 lo = grid.coords(p - glm::vec2(radius, radius)), hi = grid.coords(p + glm::vec2(radius, radius));
+	uint16_t masks[NEIGHBORS_BATCH / 16];
+	for (int row = lo.y; row <= hi.y; ++row) {
+		//cells lo.x .. hi.x of a row are one run of slots:
+		uint32_t begin = grid.starts[row * grid.size.x + lo.x], end = grid.starts[row * grid.size.x + hi.x + 1];
+		for (uint32_t b = begin; b < end; b += NEIGHBORS_BATCH) {
+			uint32_t n = std::min(uint32_t(NEIGHBORS_BATCH), end - b);
+			//(whole groups of sixteen, reading on into the next run or the padding; bits past 'n' are ignored)
+			circle_overlaps(x.data() + b, y.data() + b, (n + 15) & ~15U, p, radius, masks);
+			//write every slot, but only advance past the hits (no branches on the mask bits):
+			size_t used = out->size();
+			out->resize(used + n);
+			uint32_t *to = out->data() + used;
+			for (uint32_t k = 0; k < n; ++k) {
+				*to = b + k;
+				to += (masks[k / 16] >> (k % 16)) & 1;
+			}
+			out->resize(to - out->data());
+		}
+	}
+}
+
+void Neighbors::nearest(glm::vec2 const &p, uint32_t k, std::vector< Hit > *out) const {
+	out->clear();
+	if (grid.items.empty() || k == 0) return;
+	auto closer = [](Hit const &a, Hit const &b) {
+		return a.distance2 < b.distance2 || (a.distance2 == b.distance2 && a.slot < b.slot);
+	};
+	glm::ivec2 c = grid.coords(p);
+	float cell_size = 1.0f / grid.inv_cell_size;
+	int rings = std::max(grid.size.x, grid.size.y);
+	auto visit = [&](int cx, int cy) {
+		uint32_t cell = cy * grid.size.x + cx;
+		for (uint32_t s = grid.starts[cell]; s < grid.starts[cell + 1]; ++s) {
+			float dx = x[s] - p.x, dy = y[s] - p.y;
+			out->emplace_back(Hit{dx * dx + dy * dy, s});
+		}
+	};
+	for (int ring = 0; ring < rings; ++ring) {
+		//every cell exactly 'ring' cells from the query's cell (in x or y):
+		for (int cy = std::max(c.y - ring, 0); cy <= std::min(c.y + ring, grid.size.y - 1); ++cy) {
+			if (cy == c.y - ring || cy == c.y + ring) {
+				for (int cx = std::max(c.x - ring, 0); cx <= std::min(c.x + ring, grid.size.x - 1); ++cx) visit(cx, cy);
+			} else {
+				if (c.x - ring >= 0) visit(c.x - ring, cy);
+				if (c.x + ring < grid.size.x) visit(c.x + ring, cy);
+			}
+		}
+		//anything in a further ring is at least 'ring' whole cells away:
+		if (out->size() >= k) {
+			std::nth_element(out->begin(), out->begin() + (k - 1), out->end(), closer);
+			float reach = ring * cell_size;
+			if ((*out)[k - 1].distance2 <= reach * reach) break;
+		}
+	}
+	std::sort(out->begin(), out->end(), closer);
+	if (out->size() > k) out->resize(k);
+}
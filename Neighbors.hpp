@@ -0,0 +1,54 @@
+#pragma once
+/*
+ * Neighbors answers "who is near here" queries over a set of points (usually the flock's
+ * sheep), for behaviour that looks further than touching distance.
+ *
+ * build() bins the points into a Grid of cells 'range' wide and copies their positions out
+ * in cell order, so the points of a row of cells sit next to each other in memory. A radius
+ * query is then one contiguous run per row of cells, tested sixteen points at a time with
+ * circle_overlaps(); k-nearest queries search outward ring by ring.
+ *
+ * Queries return slots: slot k is point grid.items[k], at (x[k], y[k]). Per-point data that
+ * queries read a lot is worth copying into slot order as well.
+ *
+ * Example:
+ *   Neighbors neighbors;
+ *   neighbors.build(flock.x.data(), flock.y.data(), flock.size(), min, max, 0.1f);
+ *   std::vector< uint32_t > near;
+ *   neighbors.within(flock.pos(7), 0.1f, &near); //(includes sheep 7 itself)
+ *   for (uint32_t k : near) { uint32_t sheep = neighbors.grid.items[k]; ... }
+ *   std::vector< Neighbors::Hit > closest;
+ *   neighbors.nearest(flock.pos(7), 5, &closest);
+ */
+
+#include "Grid.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#define NEIGHBORS_PAD 16 //far-away points after the last slot (see x, y)
+
+struct Neighbors {
+	//bin 'count' points, for queries out to about 'range' (points outside [min,max] still work, just slower):
+	void build(float const *x, float const *y, uint32_t count, glm::vec2 const &min, glm::vec2 const &max, float range);
+
+	//append the slots of points closer than 'radius' to 'p', ascending:
+	void within(glm::vec2 const &p, float radius, std::vector< uint32_t > *out) const;
+
+	struct Hit {
+		float distance2; //squared distance to the query point
+		uint32_t slot;
+	};
+	//replace 'out' with the (up to) 'k' points closest to 'p', nearest first (ties by slot):
+	void nearest(glm::vec2 const &p, uint32_t k, std::vector< Hit > *out) const;
+
+	Grid grid; //grid.items[slot] is the point in each slot
+	//point positions, in slot order, then NEIGHBORS_PAD far-away points (so within() can test whole
+	// groups of sixteen past the end of a run):
+	std::vector< float > x, y;
+
+	//----- internals -----
+	std::vector< uint32_t > cells; //cell each point was binned into
+};
@@ -0,0 +1,153 @@
+#include "Obstacles.hpp"
+
+#include "Collide.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#define OBSTACLES_LEAF_SIZE 4 //most boxes per leaf
+
+void Obstacles::load(std::string const &path){
+	std::ifstream file(path);
+	if(!file) throw std::runtime_error("Failed to open level '" + path + "'.");
+	//(parsed on the side, so a bad file leaves the boxes and hierarchy as they were)
+	std::vector< Box > parsed;
+	std::string line;
+	for(uint32_t number=1;std::getline(file, line);number++){
+		std::istringstream in(line);
+		std::string word;
+		if(!(in >> word) || word[0] == '#') continue; //blank or comment
+		glm::vec2 a, b;
+		if((word != "fence" && word != "rock") || !(in >> a.x >> a.y >> b.x >> b.y)){
+			throw std::runtime_error(path + ":" + std::to_string(number) + ": expected 'fence' or 'rock' and four numbers.");
+		}
+		parsed.emplace_back(Box{glm::min(a,b), glm::max(a,b), word == "fence" ? Fence : Rock});
+	}
+	boxes.swap(parsed);
+	build();
+}
+
+void Obstacles::build(){
+	nodes.clear();
+	order.clear();
+	depth = 0;
+	if(boxes.empty()){
+		min = max = glm::vec2(0.0f);
+		thinnest = 0.0f;
+		return;
+	}
+	min = boxes[0].min;
+	max = boxes[0].max;
+	thinnest = boxes[0].max.x - boxes[0].min.x;
+	for(Box const &box : boxes){
+		min = glm::min(min, box.min);
+		max = glm::max(max, box.max);
+		thinnest = std::min(thinnest, std::min(box.max.x - box.min.x, box.max.y - box.min.y));
+	}
+	for(uint32_t i=0;i<boxes.size();i++) order.emplace_back(i);
+	nodes.emplace_back();
+	build_node(0, 0, uint32_t(order.size()), 1);
+}
+
+void Obstacles::build_node(uint32_t node, uint32_t begin, uint32_t end, uint32_t level){
+	depth = std::max(depth, level);
+	glm::vec2 lo = boxes[order[begin]].min, hi = boxes[order[begin]].max;
+	glm::vec2 center_lo = 0.5f*(lo+hi), center_hi = center_lo;
+	for(uint32_t k=begin;k<end;k++){
+		Box const &box = boxes[order[k]];
+		lo = glm::min(lo, box.min);
+		hi = glm::max(hi, box.max);
+		center_lo = glm::min(center_lo, 0.5f*(box.min+box.max));
+		center_hi = glm::max(center_hi, 0.5f*(box.min+box.max));
+	}
+	nodes[node].min = lo;
+	nodes[node].max = hi;
+	if(end - begin <= OBSTACLES_LEAF_SIZE){
+		nodes[node].first = begin;
+		nodes[node].count = end - begin;
+		return;
+	}
+
+	//split at the median box center along the axis the centers spread out most on:
+	int axis = (center_hi.x - center_lo.x >= center_hi.y - center_lo.y ? 0 : 1);
+	uint32_t mid = (begin + end) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [this,axis](uint32_t a, uint32_t b){
+		return boxes[a].min[axis] + boxes[a].max[axis] < boxes[b].min[axis] + boxes[b].max[axis];
+	});
+	uint32_t first = uint32_t(nodes.size());
+	nodes[node].first = first;
+	nodes[node].count = 0;
+	nodes.emplace_back();
+	nodes.emplace_back();
+	build_node(first, begin, mid, level+1);
+	build_node(first+1, mid, end, level+1);
+}
+
+void Obstacles::query(glm::vec2 const &qmin, glm::vec2 const &qmax, std::vector< uint32_t > *out) const {
+	if(nodes.empty()) return;
+	auto touches = [&](glm::vec2 const &a, glm::vec2 const &b){
+		return a.x < qmax.x && b.x > qmin.x && a.y < qmax.y && b.y > qmin.y;
+	};
+	uint32_t stack[64];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while(top){
+		Node const &node = nodes[stack[--top]];
+		if(!touches(node.min, node.max)) continue;
+		if(node.count){
+			for(uint32_t k=node.first;k<node.first+node.count;k++){
+				if(touches(boxes[order[k]].min, boxes[order[k]].max)) out->emplace_back(order[k]);
+			}
+		}else{
+			stack[top++] = node.first;
+			stack[top++] = node.first+1;
+		}
+	}
+}
+
+void Obstacles::overlaps(float const *x, float const *y, uint32_t count, float radius, uint8_t *touched) const {
+	if(nodes.empty() || count == 0) return;
+	//one row of per-group masks for each level of the walk; row 0 is everyone:
+	uint32_t groups = (count+15)/16;
+	std::vector< uint16_t > masks((depth+1)*groups);
+	for(uint32_t g=0;g<groups;g++){
+		uint32_t in = std::min(16U, count - 16*g);
+		masks[g] = uint16_t((1U << in) - 1);
+	}
+	overlaps_node(0, x, y, count, radius, masks.data(), masks.data() + groups, touched);
+}
+
+void Obstacles::overlaps_node(uint32_t n, float const *x, float const *y, uint32_t count, float radius,
+	uint16_t const *active, uint16_t *scratch, uint8_t *touched) const {
+	//'active' has a bit for every sheep that overlaps this node's box (the root's, for the root):
+	uint32_t groups = (count+15)/16;
+	Node const &node = nodes[n];
+	if(node.count){
+		for(uint32_t k=node.first;k<node.first+node.count;k++){
+			Box const &box = boxes[order[k]];
+			for(uint32_t g=0;g<groups;g++){
+				if(!active[g]) continue;
+				uint16_t hit;
+				aabb_overlaps(x + 16*g, y + 16*g, std::min(16U, count - 16*g), radius, box.min, box.max, &hit);
+				hit &= active[g];
+				for(uint32_t b=0;hit;b++,hit>>=1){
+					if(hit & 1) touched[16*g+b] |= uint8_t(1 << box.kind);
+				}
+			}
+		}
+		return;
+	}
+	for(uint32_t child=node.first;child<node.first+2;child++){
+		bool any = false;
+		for(uint32_t g=0;g<groups;g++){
+			scratch[g] = 0;
+			if(!active[g]) continue;
+			aabb_overlaps(x + 16*g, y + 16*g, std::min(16U, count - 16*g), radius, nodes[child].min, nodes[child].max, &scratch[g]);
+			scratch[g] &= active[g];
+			any |= (scratch[g] != 0);
+		}
+		if(any) overlaps_node(child, x, y, count, radius, scratch, scratch + groups, touched);
+	}
+}
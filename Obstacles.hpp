@@ -0,0 +1,70 @@
+#pragma once
+/*
+ * Obstacles is the static level geometry -- fence segments and rocks -- as axis-aligned boxes,
+ * indexed by a bounding volume hierarchy so testing a sheep costs O(log k) in the box count.
+ *
+ * Sheep touching a Fence box end the game; sheep touching a Rock turn around. A gap between
+ * fence segments is a gate. Levels load from a text file, one box per line:
+ *   # comment
+ *   fence min_x min_y max_x max_y
+ *   rock min_x min_y max_x max_y
+ *
+ * overlaps() tests a whole batch of sheep at once: it walks the hierarchy one time for the
+ * batch, testing each node against sixteen sheep at a time with aabb_overlaps() and skipping
+ * groups of sixteen that already missed the node.
+ *
+ * Example:
+ *   Obstacles obstacles;
+ *   obstacles.load("pasture.level"); //or add() boxes, then build()
+ *   std::vector< uint8_t > touched(count, 0);
+ *   obstacles.overlaps(x, y, count, radius, touched.data());
+ *   if (touched[i] & (1 << Obstacles::Fence)) { ... }
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Obstacles {
+	enum Kind : uint8_t {
+		Fence = 0, //touching it ends the game
+		Rock = 1, //touching it turns a sheep around
+	};
+	struct Box {
+		glm::vec2 min, max;
+		Kind kind;
+	};
+
+	//replace the boxes with the ones in a level file and build(); throws std::runtime_error on bad files, leaving everything as it was:
+	void load(std::string const &path);
+	void clear() { boxes.clear(); build(); }
+	void add(glm::vec2 const &min, glm::vec2 const &max, Kind kind) { boxes.emplace_back(Box{min, max, kind}); }
+	//(re)build the hierarchy; call after add():
+	void build();
+
+	//append the indices of boxes overlapping [min,max] to 'out':
+	void query(glm::vec2 const &min, glm::vec2 const &max, std::vector< uint32_t > *out) const;
+
+	//for each sheep i (box of half-size 'radius' at x[i],y[i]), set bit (1 << kind) in touched[i]
+	// for every kind of box it overlaps (same float comparisons as aabb_overlaps):
+	void overlaps(float const *x, float const *y, uint32_t count, float radius, uint8_t *touched) const;
+
+	std::vector< Box > boxes;
+	glm::vec2 min = glm::vec2(0.0f), max = glm::vec2(0.0f); //bounds of all boxes
+	float thinnest = 0.0f; //smallest width or height of any box (anything moving further per step should sweep)
+
+	//----- internals -----
+	struct Node {
+		glm::vec2 min, max;
+		uint32_t first; //leaf: first index in 'order'; inner: index of first child (second is first+1)
+		uint32_t count; //leaf: boxes in 'order'; inner: 0
+	};
+	std::vector< Node > nodes; //[0] is the root (when there are any boxes)
+	std::vector< uint32_t > order; //box indices, grouped by leaf
+	uint32_t depth = 0; //levels in the hierarchy
+	void build_node(uint32_t node, uint32_t begin, uint32_t end, uint32_t level); //fill nodes[node] with order[begin,end)
+	void overlaps_node(uint32_t node, float const *x, float const *y, uint32_t count, float radius,
+		uint16_t const *active, uint16_t *scratch, uint8_t *touched) const;
+};
@@ -0,0 +1,248 @@
+#include "Packed.hpp"
+
+#include "Rng.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+//unit steps along each axis for a Flock::Direction (as Flock::dir_x/dir_y):
+static int32_t step_x(uint8_t d){ return int32_t(d == Flock::Right) - int32_t(d == Flock::Left); }
+static int32_t step_y(uint8_t d){ return int32_t(d == Flock::Up) - int32_t(d == Flock::Down); }
+
+static uint16_t clamp16(int32_t v){
+	return uint16_t(std::min(std::max(v, 0), 65535));
+}
+
+//does a sheep at (x,y) with half-size r overlap box {min x, min y, max x, max y}:
+static bool overlaps(int32_t x, int32_t y, int32_t r, int32_t const box[4]){
+	return x - r < box[2] && x + r > box[0] &&
+	       y - r < box[3] && y + r > box[1];
+}
+
+PackedWorld::PackedWorld(World const &world){
+	speed = world.speed;
+	radius = world.radius;
+	dog = world.dogs[0];
+	total_time = world.total_time;
+	game_over = world.game_over;
+	seed = world.seed;
+	tick = world.tick;
+
+	//everything that matters happens inside the outer edge of the fence:
+	extent = FENCE_BOUND + FENCE_RAD;
+	if(!world.obstacles.boxes.empty()){
+		glm::vec2 far = glm::max(glm::abs(world.obstacles.min), glm::abs(world.obstacles.max));
+		extent = std::max(far.x, far.y);
+	}
+	scale = 65535.0f / (2.0f * extent);
+	r = int32_t(lroundf(radius * scale));
+
+	//obstacles, snapped to the lattice (whole numbers are exact in floats, so queries compare like integers):
+	for(Obstacles::Box const &box : world.obstacles.boxes){
+		obstacles.add(glm::vec2(quantize(box.min.x), quantize(box.min.y)), glm::vec2(quantize(box.max.x), quantize(box.max.y)), box.kind);
+	}
+	obstacles.build();
+
+	Flock const &flock = world.flock;
+	std::vector< uint8_t > dog_collide = world.dog_touches(0);
+	sheep.resize(flock.size());
+	int32_t reset = int32_t(SHEEP_RESET_TIME * PACKED_TIMER_RATE);
+	for(uint32_t i=0;i<flock.size();i++){
+		PackedSheep &s = sheep[i];
+		s.x = uint16_t(quantize(flock.x[i]));
+		s.y = uint16_t(quantize(flock.y[i]));
+		s.switch_at = uint16_t(clock + reset - int32_t(lroundf((total_time - flock.switched_at[i]) * PACKED_TIMER_RATE)));
+		s.flags = uint8_t(flock.dir[i] | (dog_collide[i] ? PackedSheep::DogBit : 0));
+		s.pad = 0;
+	}
+}
+
+int32_t PackedWorld::quantize(float v) const {
+	return clamp16(int32_t(lroundf((v + extent) * scale)));
+}
+
+void PackedWorld::unpack(World &world) const {
+	Flock &flock = world.flock;
+	flock.clear();
+	for(PackedSheep const &s : sheep){
+		flock.add(glm::vec2(dequantize(s.x), dequantize(s.y)), s.dir());
+		int32_t left = int16_t(uint16_t(s.switch_at - clock)); //ticks until the switch
+		flock.switched_at.back() = total_time - (SHEEP_RESET_TIME - float(left) / PACKED_TIMER_RATE);
+	}
+	world.speed = speed;
+	world.radius = radius;
+	world.dogs.assign(1, dog);
+	world.dog_contacts.clear();
+	for(uint32_t i=0;i<sheep.size();i++){
+		if(sheep[i].flags & PackedSheep::DogBit) world.dog_contacts.emplace_back(World::dog_contact(i, 0));
+	}
+	world.total_time = total_time;
+	world.game_over = game_over;
+	world.tick = tick;
+	world.reschedule();
+}
+
+bool PackedWorld::advance_range(uint32_t begin, uint32_t end, int32_t const dog_box[4]){
+	//as World::advance_range, everything here only touches sheep in [begin,end):
+	bool hit = false;
+	std::vector< uint32_t > near;
+	for(uint32_t i=begin;i<end;i++){
+		PackedSheep &s = sheep[i];
+		uint8_t d = s.dir();
+		int32_t x = clamp16(s.x + step_x(d) * travel),
+		        y = clamp16(s.y + step_y(d) * travel);
+		s.x = uint16_t(x);
+		s.y = uint16_t(y);
+
+		//sheep/obstacle collision (fences end the game, rocks turn sheep around)
+		near.clear();
+		obstacles.query(glm::vec2(float(x - r), float(y - r)), glm::vec2(float(x + r), float(y + r)), &near);
+		bool rock = false;
+		for(uint32_t b : near){
+			hit |= (obstacles.boxes[b].kind == Obstacles::Fence);
+			rock |= (obstacles.boxes[b].kind == Obstacles::Rock);
+		}
+		if(rock){
+			x = clamp16(x - step_x(d) * travel);
+			y = clamp16(y - step_y(d) * travel);
+			s.x = uint16_t(x);
+			s.y = uint16_t(y);
+			s.set_dir(d ^ 1);
+		}
+
+		//sheep/dog collision (only flip velocity if just collided)
+		uint8_t touch = overlaps(x, y, r, dog_box) ? PackedSheep::DogBit : 0;
+		uint8_t flip = (touch & ~s.flags) ? 1 : 0;
+		s.flags = uint8_t(((s.flags & PackedSheep::DirBits) ^ flip) | touch);
+
+		cells[i] = cell(s);
+	}
+	return hit;
+}
+
+void PackedWorld::gather_candidates(uint32_t i, uint32_t begin){
+	//as World::gather_candidates (grid case): sheep in [begin,i) binned or strayed near sheep i:
+	candidates.clear();
+	gathered_cell = cell(sheep[i]);
+	int cx = gathered_cell % grid.size.x, cy = gathered_cell / grid.size.x;
+	for(int y=std::max(cy-1,0);y<=std::min(cy+1,grid.size.y-1);y++){
+		for(int x=std::max(cx-1,0);x<=std::min(cx+1,grid.size.x-1);x++){
+			uint32_t c = y*grid.size.x+x;
+			for(uint32_t k=grid.starts[c];k<grid.starts[c+1];k++){
+				uint32_t j = grid.items[k];
+				if(j >= begin && j < i) candidates.emplace_back(j);
+			}
+			for(int32_t n=stray_head[c];n!=-1;n=strays[n].next){
+				uint32_t j = strays[n].sheep;
+				if(j >= begin && j < i) candidates.emplace_back(j);
+			}
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+}
+
+void PackedWorld::note_bounced(uint32_t s){
+	uint32_t c = cell(sheep[s]);
+	if(c != stray_cell[s]){
+		stray_cell[s] = c;
+		strays.emplace_back(World::Stray{s, c, stray_head[c]});
+		stray_head[c] = strays.size()-1;
+	}
+}
+
+void PackedWorld::bounce(uint32_t a, uint32_t b){
+	//as World's bounce(), on the lattice (both sheep move at the same speed, so distances stand in for times):
+	PackedSheep &sa = sheep[a], &sb = sheep[b];
+	uint8_t da = sa.dir(), db = sb.dir();
+
+	//reset to pre-collision so collision only happens once
+	sa.x = clamp16(sa.x - step_x(da) * travel);
+	sa.y = clamp16(sa.y - step_y(da) * travel);
+	sb.x = clamp16(sb.x - step_x(db) * travel);
+	sb.y = clamp16(sb.y - step_y(db) * travel);
+
+	if(da == (db ^ 1)){ //direct collision
+		sa.set_dir(da ^ 1);
+		sb.set_dir(db ^ 1);
+	}else{ //t-bone collision
+		int32_t dist_x = std::abs(int32_t(sb.x) - int32_t(sa.x)),
+		        dist_y = std::abs(int32_t(sb.y) - int32_t(sa.y));
+		bool a_moves_y = step_x(da) == 0;
+		int32_t dist_a = a_moves_y ? dist_y : dist_x,
+		        dist_b = a_moves_y ? dist_x : dist_y;
+		if(dist_a <= dist_b){ //sheep b 'rams' sheep a
+			sa.set_dir(db);
+			sb.set_dir(db ^ 1);
+		}else{ //sheep a 'rams' sheep b
+			sb.set_dir(da);
+			sa.set_dir(da ^ 1);
+		}
+	}
+}
+
+void PackedWorld::step(float elapsed, glm::vec2 const &dog_pos){
+	dog = dog_pos;
+	total_time += elapsed;
+	tick += 1;
+
+	//everyone moves the same whole number of steps; the leftover fraction waits for next time:
+	double moved = double(speed) * elapsed * scale + travel_carry;
+	travel = int32_t(moved);
+	travel_carry = moved - travel;
+	double ticked = double(elapsed) * PACKED_TIMER_RATE + clock_carry;
+	uint32_t ticks = uint32_t(ticked);
+	clock_carry = ticked - ticks;
+	clock += ticks;
+
+	int32_t dog_box[4] = {
+		quantize(dog.x - DOG_SCALE*radius), quantize(dog.y - DOG_SCALE*radius),
+		quantize(dog.x + DOG_SCALE*radius), quantize(dog.y + DOG_SCALE*radius),
+	};
+
+	uint32_t count = uint32_t(sheep.size());
+	grid.reset(glm::vec2(0.0f), glm::vec2(65535.0f), float(2*r));
+	cells.resize(count);
+	if(pool && pool->size() > 1){
+		uint32_t chunks = (count+WORLD_GRAIN-1)/WORLD_GRAIN;
+		chunk_hits.assign(chunks, 0);
+		pool->parallel_for(count, WORLD_GRAIN, [this,&dog_box](uint32_t begin, uint32_t end){
+			chunk_hits[begin/WORLD_GRAIN] = advance_range(begin, end, dog_box);
+		});
+		for(uint8_t hit : chunk_hits) if(hit) game_over = true;
+	}else{
+		if(advance_range(0, count, dog_box)) game_over = true;
+	}
+	grid.build(cells);
+	for(World::Stray const &s : strays) stray_head[s.cell] = -1;
+	strays.clear();
+	stray_head.resize(grid.size.x*grid.size.y, -1);
+	stray_cell = cells;
+
+	uint16_t now = uint16_t(clock);
+	for(uint32_t i=0;i<count;i++){
+		//sheep/sheep collision, against earlier sheep in index order:
+		gather_candidates(i, 0);
+		for(uint32_t k=0;k<candidates.size();k++){
+			uint32_t j = candidates[k];
+			if(std::abs(int32_t(sheep[i].x) - int32_t(sheep[j].x)) >= 2*r ||
+			   std::abs(int32_t(sheep[i].y) - int32_t(sheep[j].y)) >= 2*r) continue;
+			bounce(i, j);
+			note_bounced(i);
+			note_bounced(j);
+			if(cell(sheep[i]) != gathered_cell){
+				gather_candidates(i, j+1);
+				k = -1U;
+			}
+		}
+
+		//INTRODUCE MOVEMENT RANDOMNESS PERIODICALLY
+		if(int16_t(uint16_t(now - sheep[i].switch_at)) > 0){
+			sheep[i].set_dir(random_direction(seed, i, tick));
+			sheep[i].switch_at = uint16_t(now + int32_t(SHEEP_RESET_TIME * PACKED_TIMER_RATE));
+		}
+	}
+
+	speed += elapsed*SPEEDUP; //sheep speed increases over time
+}
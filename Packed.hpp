@@ -0,0 +1,99 @@
+#pragma once
+/*
+ * PackedWorld runs the sheep game on sheep squeezed into 8 bytes each, for flocks too big
+ * to keep at full precision in RAM (or cache).
+ *
+ * Positions are 16-bit fixed point across the fenced arena (about 2.5e-5 units per step at
+ * the default fence size). Everyone moves the same distance each step, so the fractional part
+ * of that distance is carried once for the whole flock instead of per sheep, and nobody
+ * drifts. The switch timer is the low 16 bits of the (1/1024 s) clock at which the sheep
+ * next switches, so it only gets written when a sheep actually switches.
+ *
+ * Rules are the same as World::step, evaluated on the lattice, so results track World's
+ * closely but not bit-for-bit. There are no swept tests: keep steps short (as FixedStep does).
+ * Only the world's first dog is followed.
+ *
+ * Example:
+ *   World world(1000000, seed);
+ *   PackedWorld packed(world); //8 MB instead of 14
+ *   packed.step(1.0f / 120.0f, dog);
+ *   packed.unpack(world); //back to floats, for drawing
+ */
+
+#include "World.hpp"
+#include "Grid.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#define PACKED_TIMER_RATE 1024 //switch timer steps per second (timers cover +/- 32 s)
+
+struct PackedSheep {
+	uint16_t x, y; //fixed point, 0 = left/bottom edge of the arena, 65535 = right/top edge
+	uint16_t switch_at; //low 16 bits of the clock at which this sheep next switches direction
+	uint8_t flags; //bits 0-1: Flock::Direction, bit 2: dog overlapping
+	uint8_t pad;
+
+	enum : uint8_t {
+		DirBits = 0x3,
+		DogBit = 0x4,
+	};
+	uint8_t dir() const { return flags & DirBits; }
+	void set_dir(uint8_t d) { flags = uint8_t((flags & ~DirBits) | d); }
+};
+static_assert(sizeof(PackedSheep) == 8, "PackedSheep should pack into 8 bytes");
+
+struct PackedWorld {
+	//quantize 'world' (sheep, dog, speed, timers, and random seed):
+	explicit PackedWorld(World const &world);
+
+	//advance the game by 'elapsed' seconds, with the dog moved to 'dog_pos' (as World::step):
+	void step(float elapsed, glm::vec2 const &dog_pos);
+
+	//write everything back to 'world' at full precision (the dog as the world's only dog):
+	void unpack(World &world) const;
+
+	//if set, step() splits per-sheep work across this pool (results are identical either way):
+	ThreadPool *pool = nullptr;
+
+	std::vector< PackedSheep > sheep;
+	float speed;
+	float radius;
+	glm::vec2 dog;
+	float total_time;
+	bool game_over;
+	uint32_t seed, tick;
+
+	//----- internals -----
+	//arena <-> fixed point:
+	float extent; //arena is [-extent,extent] on both axes
+	float scale; //fixed-point steps per unit
+	int32_t quantize(float v) const;
+	float dequantize(int32_t q) const { return q / scale - extent; }
+
+	int32_t r; //sheep half-size, in fixed-point steps
+	Obstacles obstacles; //World's obstacles, in fixed-point steps
+	int32_t travel = 0; //fixed-point steps moved this step
+	double travel_carry = 0.0; //fraction of a step owed to everyone
+	uint32_t clock = 0; //in 1/PACKED_TIMER_RATE seconds
+	double clock_carry = 0.0;
+
+	//move, fence-test, dog-test, and bin sheep [begin,end); returns true if any hit the fence:
+	bool advance_range(uint32_t begin, uint32_t end, int32_t const dog_box[4]);
+	std::vector< uint8_t > chunk_hits; //per-chunk fence hits when running on 'pool'
+
+	//uniform grid broadphase over fixed-point coordinates, as in World:
+	Grid grid;
+	std::vector< uint32_t > cells;
+	std::vector< World::Stray > strays;
+	std::vector< int32_t > stray_head;
+	std::vector< uint32_t > stray_cell;
+	std::vector< uint32_t > candidates;
+	uint32_t gathered_cell = 0;
+	uint32_t cell(PackedSheep const &s) const { return grid.cell(glm::vec2(s.x, s.y)); }
+	void gather_candidates(uint32_t i, uint32_t begin);
+	void note_bounced(uint32_t s);
+	void bounce(uint32_t a, uint32_t b);
+};
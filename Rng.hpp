@@ -0,0 +1,45 @@
+#pragma once
+/*
+ * Rng is a counter-based random number generator: the number for (seed, stream, counter)
+ * is a pure hash of the three, with no state carried between calls. Sheep i's pick on tick t
+ * is the same whichever thread asks, in whatever order -- unlike rand(), which hands out
+ * numbers in call order from one global (and, in glibc, locked) state.
+ *
+ * The hash is Chris Wellons' 'lowbias32' (xorshift-multiply rounds, as in SplitMix) applied
+ * once per key word. It is all 32-bit integer math, so the batch version vectorizes.
+ *
+ * Example:
+ *   uint8_t d = random_direction(seed, sheep, tick); //one sheep
+ *   random_directions(seed, 0, count, tick, dirs.data()); //a whole flock
+ */
+
+#include <cstdint>
+
+//well-mixed 32-bit hash of 'x':
+inline uint32_t rng_hash(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+//random 32 bits for number 'counter' of stream 'stream':
+inline uint32_t rng_u32(uint32_t seed, uint32_t stream, uint32_t counter) {
+	return rng_hash(rng_hash(rng_hash(seed) ^ stream) ^ counter);
+}
+
+//random Flock::Direction for sheep 'sheep' at 'counter' (from the top bits, which mix best):
+inline uint8_t random_direction(uint32_t seed, uint32_t sheep, uint32_t counter) {
+	return uint8_t(rng_u32(seed, sheep, counter) >> 30);
+}
+
+//random_direction() for sheep [first, first+count), into out[0..count):
+inline void random_directions(uint32_t seed, uint32_t first, uint32_t count, uint32_t counter, uint8_t *out) {
+	uint32_t key = rng_hash(seed);
+	//(no dependence between iterations, so this vectorizes wherever the compiler vectorizes loops, e.g. -O3)
+	for (uint32_t i = 0; i < count; ++i) {
+		out[i] = uint8_t(rng_hash(rng_hash(key ^ (first + i)) ^ counter) >> 30);
+	}
+}
@@ -0,0 +1,83 @@
+#include "SheepEnv.h"
+
+#include "Batch.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <new>
+#include <vector>
+
+struct SheepEnv {
+	SheepEnv(uint32_t games, uint32_t sheep, uint32_t seed, float tick_rate, uint32_t threads)
+		: pool(threads), batch(games, int(sheep), seed), tick(1.0f / tick_rate), dogs(games) {
+		batch.pool = &pool;
+	}
+	ThreadPool pool;
+	BatchWorld batch;
+	float tick; //seconds per step
+	std::vector< glm::vec2 > dogs; //per game, from the last actions
+
+	uint32_t observation_size() const { return 3 + 4*batch.sheep; }
+	void observe(uint32_t game, float *out) const;
+};
+
+void SheepEnv::observe(uint32_t game, float *out) const {
+	out[0] = batch.dogs[game].x;
+	out[1] = batch.dogs[game].y;
+	out[2] = batch.speed[game];
+	out += 3;
+	for(uint32_t s=0;s<batch.sheep;s++){
+		size_t at = batch.lane(game, s);
+		out[0] = batch.x[at];
+		out[1] = batch.y[at];
+		out[2] = Flock::dir_x(batch.dir[at]);
+		out[3] = Flock::dir_y(batch.dir[at]);
+		out += 4;
+	}
+}
+
+SheepEnv *sheep_env_create(uint32_t games, uint32_t sheep, uint32_t seed, float tick_rate, uint32_t threads){
+	if(games == 0 || sheep == 0 || !(tick_rate > 0.0f)) return nullptr;
+	//(nothing may throw across the C boundary)
+	try {
+		return new SheepEnv(games, sheep, seed, tick_rate, threads);
+	} catch (std::exception &) {
+		return nullptr;
+	}
+}
+
+void sheep_env_destroy(SheepEnv *env){
+	delete env;
+}
+
+uint32_t sheep_env_games(SheepEnv const *env){
+	return env->batch.games;
+}
+
+uint32_t sheep_env_observation_size(SheepEnv const *env){
+	return env->observation_size();
+}
+
+void sheep_env_reset(SheepEnv *env, uint32_t game, uint32_t seed, float *observation){
+	env->batch.reset(game, seed);
+	if(observation) env->observe(game, observation);
+}
+
+void sheep_env_step(SheepEnv *env, float const *actions, float *observations, float *rewards, uint8_t *dones){
+	BatchWorld &batch = env->batch;
+	for(uint32_t g=0;g<batch.games;g++){
+		//BatchWorld only tests the dog where it ends up, so it can't be allowed to jump over a sheep:
+		// (per axis, dog move + sheep travel has to stay under the width of the touching band -- World's sweep_dog threshold)
+		float travel = batch.speed[g] * env->tick;
+		float limit = std::max(0.999f * (2.0f * (1.0f + DOG_SCALE) * batch.radius - travel), 0.0f);
+		glm::vec2 from = batch.dogs[g];
+		env->dogs[g] = glm::min(glm::max(glm::vec2(actions[2*g], actions[2*g+1]), from - glm::vec2(limit)), from + glm::vec2(limit));
+		rewards[g] = batch.game_over[g] ? 0.0f : env->tick; //(games that are over don't step)
+	}
+	batch.step_all(env->tick, env->dogs.data());
+	uint32_t size = env->observation_size();
+	for(uint32_t g=0;g<batch.games;g++){
+		env->observe(g, observations + size_t(g) * size);
+		dones[g] = batch.game_over[g];
+	}
+}
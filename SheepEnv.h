@@ -0,0 +1,68 @@
+#pragma once
+/*
+ * SheepEnv is the sheep game as a C-ABI shared library (libsheep_env.so, or sheep_env.dll),
+ * for training and scoring dog policies in-process -- from C, or Python's ctypes/cffi --
+ * instead of driving the interactive binary.
+ *
+ * One handle holds any number of independent games, stepped together through a BatchWorld
+ * (see Batch.hpp). The caller owns every buffer: step() reads the dogs from 'actions' and
+ * writes observations, rewards, and done flags straight into the arrays it is handed, and
+ * allocates nothing per step.
+ *
+ * An action is where to put the game's dog (x, y in the game's [-1,1] coordinates, as the
+ * mouse sets it in ./main). The dog walks there rather than teleporting: each step it moves at
+ * most a little under 2*(1+DOG_SCALE) sheep radii, less the sheep's travel that step, along
+ * each axis, so it can't skip over a sheep (the games are only tested where the dog ends up).
+ * The observation holds where the dog actually got to. The reward for a step is the time the game survived during it,
+ * so a game's rewards add up to its World::total_time. A game that is done stays done (and
+ * earns nothing) until it is reset.
+ *
+ * A game's observation is sheep_env_observation_size() floats:
+ *   dog x, dog y, sheep speed, then for each sheep: x, y, direction x, direction y
+ *
+ * Example:
+ *   SheepEnv *env = sheep_env_create(256, 5, seed, 120.0f, 1); //256 games, 5 sheep each
+ *   uint32_t size = sheep_env_observation_size(env);
+ *   float *obs = malloc(256 * size * sizeof(float)), actions[256 * 2], rewards[256];
+ *   uint8_t dones[256];
+ *   for (g = 0; g < 256; ++g) sheep_env_reset(env, g, seed + g, obs + g * size);
+ *   for (...) {
+ *     ... //policy: obs -> actions
+ *     sheep_env_step(env, actions, obs, rewards, dones);
+ *     for (g = 0; g < 256; ++g) if (dones[g]) sheep_env_reset(env, g, next_seed++, obs + g * size);
+ *   }
+ *   sheep_env_destroy(env);
+ */
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define SHEEP_ENV_API __declspec(dllexport)
+#else
+#define SHEEP_ENV_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SheepEnv SheepEnv;
+
+//'games' games of 'sheep' sheep each, game g started as if reset with seed + g, stepped 1/tick_rate
+// seconds at a time on 'threads' threads (0 means one per hardware thread); NULL if it can't be made:
+SHEEP_ENV_API SheepEnv *sheep_env_create(uint32_t games, uint32_t sheep, uint32_t seed, float tick_rate, uint32_t threads);
+SHEEP_ENV_API void sheep_env_destroy(SheepEnv *env);
+
+SHEEP_ENV_API uint32_t sheep_env_games(SheepEnv const *env);
+SHEEP_ENV_API uint32_t sheep_env_observation_size(SheepEnv const *env); //floats per game
+
+//start game 'game' over with a new seed; writes its observation to 'observation' (if not NULL):
+SHEEP_ENV_API void sheep_env_reset(SheepEnv *env, uint32_t game, uint32_t seed, float *observation);
+
+//advance every game by one tick, game g's dog moved toward (actions[2g], actions[2g+1]) (as far as a step allows);
+// writes games * observation_size observations, and a reward and done flag per game:
+SHEEP_ENV_API void sheep_env_step(SheepEnv *env, float const *actions, float *observations, float *rewards, uint8_t *dones);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,105 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t thread_count) {
+	if (thread_count == 0) thread_count = std::max(1U, std::thread::hardware_concurrency());
+	for (uint32_t i = 0; i < thread_count; ++i) {
+		queues.emplace_back(new Queue);
+	}
+	for (uint32_t i = 1; i < thread_count; ++i) {
+		threads.emplace_back([this, i](){
+			uint64_t seen = 0;
+			while (true) {
+				{ //sleep until there is a new job (or it is time to stop):
+					std::unique_lock< std::mutex > lock(mutex);
+					wake.wait(lock, [&](){ return quit || job != seen; });
+					if (quit) return;
+					seen = job;
+				}
+				work(i);
+				{
+					std::unique_lock< std::mutex > lock(mutex);
+					busy -= 1;
+					if (busy == 0) done.notify_all();
+				}
+			}
+		});
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::parallel_for(uint32_t count_, uint32_t grain_, std::function< void(uint32_t, uint32_t) > const &fn_) {
+	if (count_ == 0) return;
+	grain_ = std::max(grain_, 1U);
+	uint32_t chunks = (count_ + grain_ - 1) / grain_;
+	if (threads.empty() || chunks == 1) {
+		fn_(0, count_);
+		return;
+	}
+
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		fn = &fn_;
+		count = count_;
+		grain = grain_;
+		//deal out contiguous runs of chunks so neighbouring chunks (usually) share a worker:
+		uint32_t workers = size();
+		for (uint32_t w = 0; w < workers; ++w) {
+			std::unique_lock< std::mutex > queue_lock(queues[w]->mutex);
+			queues[w]->front = uint32_t(uint64_t(chunks) * w / workers);
+			queues[w]->back = uint32_t(uint64_t(chunks) * (w + 1) / workers);
+		}
+		busy = uint32_t(threads.size());
+		job += 1;
+	}
+	wake.notify_all();
+
+	work(0);
+
+	//helpers may still be finishing their last chunk:
+	std::unique_lock< std::mutex > lock(mutex);
+	done.wait(lock, [&](){ return busy == 0; });
+	fn = nullptr;
+}
+
+void ThreadPool::work(uint32_t self) {
+	uint32_t chunk;
+	while (take(self, &chunk)) {
+		uint32_t begin = chunk * grain;
+		uint32_t end = std::min(count, begin + grain);
+		(*fn)(begin, end);
+	}
+}
+
+bool ThreadPool::take(uint32_t self, uint32_t *chunk) {
+	{ //own work first, from the front:
+		Queue &queue = *queues[self];
+		std::unique_lock< std::mutex > lock(queue.mutex);
+		if (queue.front < queue.back) {
+			*chunk = queue.front++;
+			return true;
+		}
+	}
+	//then steal from the back of the other workers' runs:
+	uint32_t workers = size();
+	for (uint32_t offset = 1; offset < workers; ++offset) {
+		Queue &queue = *queues[(self + offset) % workers];
+		std::unique_lock< std::mutex > lock(queue.mutex);
+		if (queue.front < queue.back) {
+			*chunk = --queue.back;
+			return true;
+		}
+	}
+	return false;
+}
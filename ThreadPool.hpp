@@ -0,0 +1,59 @@
+#pragma once
+/*
+ * ThreadPool is a small work-stealing pool for splitting loops across cores.
+ *
+ * parallel_for() cuts [0,count) into chunks and deals each worker a contiguous run of them;
+ * workers take chunks from the front of their own run, and when it is empty steal from the
+ * back of someone else's. The calling thread works too, and the call returns once every
+ * chunk is done. A pool of size 1 just runs the loop on the caller.
+ *
+ * Example:
+ *   ThreadPool pool(4);
+ *   pool.parallel_for(values.size(), 1024, [&](uint32_t begin, uint32_t end){
+ *     for (uint32_t i = begin; i < end; ++i) values[i] *= 2.0f;
+ *   });
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ThreadPool {
+	//'threads' counts the calling thread; 0 means one per hardware thread:
+	explicit ThreadPool(uint32_t threads = 0);
+	~ThreadPool();
+	ThreadPool(ThreadPool const &) = delete;
+	ThreadPool &operator=(ThreadPool const &) = delete;
+
+	//call fn(begin, end) over [0,count) in chunks of 'grain' items; returns when all are done:
+	void parallel_for(uint32_t count, uint32_t grain, std::function< void(uint32_t, uint32_t) > const &fn);
+
+	uint32_t size() const { return uint32_t(queues.size()); }
+
+	//----- internals -----
+	//range of chunk indices still to run, owned by one worker:
+	struct Queue {
+		std::mutex mutex;
+		uint32_t front = 0, back = 0;
+	};
+	std::vector< std::unique_ptr< Queue > > queues; //one per worker; [0] is the calling thread
+	std::vector< std::thread > threads;
+
+	std::mutex mutex; //guards everything below
+	std::condition_variable wake, done;
+	uint64_t job = 0; //bumped for every parallel_for
+	uint32_t busy = 0; //helper threads still inside the current job
+	bool quit = false;
+
+	//current job:
+	std::function< void(uint32_t, uint32_t) > const *fn = nullptr;
+	uint32_t count = 0, grain = 1;
+
+	void work(uint32_t self);
+	bool take(uint32_t self, uint32_t *chunk);
+};
@@ -0,0 +1,58 @@
+#pragma once
+/*
+ * TimingWheel schedules items (e.g. sheep indices) to come due at a time, and hands back only
+ * the items whose time has come, instead of checking everyone every step.
+ *
+ * Time is cut into 'slot_time'-second slots, and a ring of slots holds the items due in each.
+ * Every deadline has to lie within the ring's span of the current time. Sheep switch every
+ * SHEEP_RESET_TIME seconds, so one ring covers every deadline and no overflow levels are needed.
+ * Items come back by slot, so ones in the last slot may not be due yet; check and re-insert.
+ *
+ * Example:
+ *   TimingWheel wheel(1.0f / 64.0f, 10.0f);
+ *   wheel.insert(sheep, now + 10.0f);
+ *   ...
+ *   wheel.advance(now, &due); //every item whose slot is at or before 'now'
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+struct TimingWheel {
+	//slots of 'slot_time' seconds, enough of them to hold deadlines up to 'span' seconds ahead:
+	explicit TimingWheel(float slot_time_ = 1.0f / 64.0f, float span = 16.0f) : slot_time(slot_time_) {
+		uint32_t count = 1;
+		while (count < uint32_t(span / slot_time) + 2) count *= 2;
+		slots.resize(count);
+	}
+
+	//drop everything and restart the clock at 'now':
+	void clear(float now = 0.0f) {
+		for (auto &slot : slots) slot.clear();
+		current = int64_t(std::floor(now / slot_time));
+	}
+
+	//schedule 'item' for time 'due' (deadlines already past go in the next slot handed out):
+	void insert(uint32_t item, float due) {
+		int64_t slot = int64_t(std::floor(due / slot_time));
+		if (slot < current) slot = current;
+		slots[slot & (slots.size() - 1)].emplace_back(item);
+	}
+
+	//append to 'out' every item in slots up to and including the one holding 'now', and empty them:
+	void advance(float now, std::vector< uint32_t > *out) {
+		int64_t target = int64_t(std::floor(now / slot_time));
+		//(no need to walk around the ring more than once)
+		if (target - current >= int64_t(slots.size())) current = target - int64_t(slots.size()) + 1;
+		for (; current <= target; ++current) {
+			std::vector< uint32_t > &slot = slots[current & (slots.size() - 1)];
+			out->insert(out->end(), slot.begin(), slot.end());
+			slot.clear();
+		}
+	}
+
+	float slot_time;
+	std::vector< std::vector< uint32_t > > slots; //size is a power of two
+	int64_t current = 0; //first slot not yet handed out
+};
@@ -0,0 +1,669 @@
+#include "World.hpp"
+
+#include "Collide.hpp"
+#include "Rng.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <math.h> //used for sheep positioning
+
+bool close_enough(float x, float y){ //float equality function
+	float absdif = x-y;
+	if(absdif<0) return absdif >= -0.00001f;
+	else         return absdif <=  0.00001f;
+}
+
+World::World(int count, uint32_t seed_) : seed(seed_) {
+	//random directions for everyone (tick 0); can only go north, south, east, or west (see Flock::Direction)
+	std::vector< uint8_t > dirs(std::max(count,0));
+	random_directions(seed, 0, uint32_t(dirs.size()), tick, dirs.data());
+
+	//initialize sheep
+	for(int i=0;i<count;i++){
+		//set sheep position
+		float angle = 2*3.14159265f/count*i;
+		glm::vec2 pos = 0.3f*glm::vec2(sin(angle),cos(angle));
+
+		flock.add(pos,dirs[i]);
+	}
+
+	//dog
+	dogs.emplace_back(FENCE_BOUND-FENCE_RAD-DOG_SCALE*radius,-FENCE_BOUND+FENCE_RAD+DOG_SCALE*radius);
+
+	//Out of Bounds
+	boundaries[0] = glm::vec2(-FENCE_BOUND,FENCE_BOUND);
+	boundaries[1] = glm::vec2(FENCE_BOUND,FENCE_BOUND);
+	boundaries[2] = glm::vec2(FENCE_BOUND,-FENCE_BOUND);
+	boundaries[3] = glm::vec2(-FENCE_BOUND,-FENCE_BOUND);
+	fence_pad = glm::vec2(FENCE_RAD,FENCE_RAD);
+	obstacles.add(boundaries[0]-fence_pad,boundaries[1]+fence_pad,Obstacles::Fence);
+	obstacles.add(boundaries[2]-fence_pad,boundaries[1]+fence_pad,Obstacles::Fence);
+	obstacles.add(boundaries[3]-fence_pad,boundaries[2]+fence_pad,Obstacles::Fence);
+	obstacles.add(boundaries[3]-fence_pad,boundaries[0]+fence_pad,Obstacles::Fence);
+	obstacles.build();
+}
+
+void World::reschedule(){
+	switches.clear(total_time);
+	for(uint32_t i=0;i<flock.size();i++) switches.insert(i, flock.switched_at[i] + SHEEP_RESET_TIME);
+	scheduled = flock.size();
+}
+
+//WorldState sections start on 8-byte boundaries:
+static size_t round8(size_t bytes){ return (bytes + 7) & ~size_t(7); }
+
+void World::snapshot(WorldState *out) const {
+	WorldState::Header header;
+	header.sheep = flock.size();
+	header.dogs = uint32_t(dogs.size());
+	header.dog_contacts = uint32_t(dog_contacts.size());
+	header.seed = seed;
+	header.tick = tick;
+	header.speed = speed;
+	header.radius = radius;
+	header.total_time = total_time;
+	header.game_over = game_over;
+	header.pad = 0;
+
+	size_t n = flock.size();
+	size_t bytes = sizeof(header) + 3*round8(n*sizeof(float)) + round8(n)
+		+ round8(dogs.size()*sizeof(glm::vec2)) + dog_contacts.size()*sizeof(uint64_t);
+	out->block.resize(bytes / sizeof(uint64_t));
+	uint8_t *at = reinterpret_cast< uint8_t * >(out->block.data());
+	auto put = [&at](void const *from, size_t size){
+		if(size) memcpy(at, from, size);
+		at += round8(size);
+	};
+	put(&header, sizeof(header));
+	put(flock.x.data(), n*sizeof(float));
+	put(flock.y.data(), n*sizeof(float));
+	put(flock.switched_at.data(), n*sizeof(float));
+	put(flock.dir.data(), n);
+	put(dogs.data(), dogs.size()*sizeof(glm::vec2));
+	put(dog_contacts.data(), dog_contacts.size()*sizeof(uint64_t));
+}
+
+void World::restore(WorldState const &state){
+	WorldState::Header header = state.header();
+	seed = header.seed;
+	tick = header.tick;
+	speed = header.speed;
+	radius = header.radius;
+	total_time = header.total_time;
+	game_over = (header.game_over != 0);
+
+	size_t n = header.sheep;
+	flock.x.resize(n);
+	flock.y.resize(n);
+	flock.switched_at.resize(n);
+	flock.dir.resize(n);
+	dogs.resize(header.dogs);
+	dog_contacts.resize(header.dog_contacts);
+	uint8_t const *at = reinterpret_cast< uint8_t const * >(state.block.data());
+	auto get = [&at](void *to, size_t size){
+		if(size) memcpy(to, at, size);
+		at += round8(size);
+	};
+	at += sizeof(header);
+	get(flock.x.data(), n*sizeof(float));
+	get(flock.y.data(), n*sizeof(float));
+	get(flock.switched_at.data(), n*sizeof(float));
+	get(flock.dir.data(), n);
+	get(dogs.data(), dogs.size()*sizeof(glm::vec2));
+	get(dog_contacts.data(), dog_contacts.size()*sizeof(uint64_t));
+
+	reschedule();
+}
+
+World World::fork() const {
+	World copy(0, seed);
+	copy.pool = pool;
+	copy.broadphase = broadphase;
+	copy.contacts = contacts;
+	copy.herding = herding;
+	copy.obstacles = obstacles;
+	WorldState state;
+	snapshot(&state);
+	copy.restore(state);
+	return copy;
+}
+
+//bounce two overlapping sheep off each other:
+static void bounce(Flock &flock, uint32_t a, uint32_t b, float speed, float elapsed){
+	//get pos and vel before collision
+	glm::vec2 vel1 = flock.vel(a)*speed,
+	          vel2 = flock.vel(b)*speed;
+	glm::vec2 prev1 = flock.pos(a) - vel1*elapsed,
+	          prev2 = flock.pos(b) - vel2*elapsed;
+
+	//reset to pre-collision so collision only happens once
+	flock.set_pos(a, prev1);
+	flock.set_pos(b, prev2);
+
+	if(close_enough(vel1.x,-vel2.x) &&
+	   close_enough(vel1.y,-vel2.y)){
+		//direct collision
+		flock.flip(a);
+		flock.flip(b);
+	}else{ //t-bone collision
+		//calculate who gets to the collision first
+		glm::vec2 dist = prev2-prev1;
+		float time1,time2;
+		if(close_enough(vel1.x,0.f)){ //a moves in y, b moves in x
+			time1 = fabsf(dist.y/vel1.y);
+			time2 = fabsf(dist.x/vel2.x);
+		}else{ //a moves in x, b moves in y
+			time1 = fabsf(dist.x/vel1.x);
+			time2 = fabsf(dist.y/vel2.y);
+		}
+
+		//based on collision, adjust velocities
+		if(time1 <= time2){ //sheep b 'rams' sheep a
+			flock.dir[a] = flock.dir[b];
+			flock.flip(b);
+		}else{ //sheep a 'rams' sheep b
+			flock.dir[b] = flock.dir[a];
+			flock.flip(a);
+		}
+	}
+}
+
+void World::gather_candidates(uint32_t i, uint32_t begin){
+	gathered_cell = grid.cell(flock.pos(i));
+	gathered_x = flock.x[i];
+	gather_candidates(i, begin, &candidates);
+}
+
+void World::gather_candidates(uint32_t i, uint32_t begin, std::vector< uint32_t > *out) const {
+	//sheep with index in [begin,i) that might overlap sheep i where it is now, in index order:
+	std::vector< uint32_t > &candidates = *out;
+	candidates.clear();
+	glm::vec2 at = flock.pos(i);
+	if(broadphase == UniformGrid){
+		//binned or strayed into the 3x3 cells around sheep i.
+		//when sweeping, a pair can meet from a cell apart plus however far bounces have rewound either of them
+		// (and neither is anywhere near where its sweep starts any more), so look that much further:
+		int around = 1;
+		if(sweep_sheep && rewinds) around += int(ceilf(2*rewinds*rewind_travel*grid.inv_cell_size));
+		uint32_t cell = grid.cell(at);
+		int cx = cell % grid.size.x, cy = cell / grid.size.x;
+		for(int y=std::max(cy-around,0);y<=std::min(cy+around,grid.size.y-1);y++){
+			for(int x=std::max(cx-around,0);x<=std::min(cx+around,grid.size.x-1);x++){
+				uint32_t c = y*grid.size.x+x;
+				for(uint32_t k=grid.starts[c];k<grid.starts[c+1];k++){
+					uint32_t j = grid.items[k];
+					if(j >= begin && j < i) candidates.emplace_back(j);
+				}
+				for(int32_t n=stray_head[c];n!=-1;n=strays[n].next){
+					uint32_t j = strays[n].sheep;
+					if(j >= begin && j < i) candidates.emplace_back(j);
+				}
+			}
+		}
+	}else if(broadphase == SortAndSweep){
+		//sorted neighbours whose x (as sorted, give or take how far bounces have since moved anyone) is in reach.
+		//when sweeping, the pair's own rewinds can also hold them apart (as for the grid), so allow for those too:
+		float reach = sap_reach + (sweep_sheep ? 3 : 1)*rewinds*rewind_travel;
+		float lo = at.x - reach, hi = at.x + reach;
+		uint32_t rank = sap_rank[i];
+		for(uint32_t k=rank;k-- > 0 && sap_x[k] >= lo;){
+			uint32_t j = sap_order[k];
+			if(j >= begin && j < i) candidates.emplace_back(j);
+		}
+		for(uint32_t k=rank+1;k<sap_order.size() && sap_x[k] <= hi;k++){
+			uint32_t j = sap_order[k];
+			if(j >= begin && j < i) candidates.emplace_back(j);
+		}
+	}else{ //AllPairs
+		for(uint32_t j=begin;j<i;j++) candidates.emplace_back(j);
+		return;
+	}
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+}
+
+void World::note_bounced(uint32_t s){
+	//each bounce rewinds a sheep by at most one step of travel; widen later scans to match:
+	bounces[s] += 1;
+	rewinds = std::max(rewinds, bounces[s]);
+	if(broadphase == UniformGrid){
+		//file sheep that left their binned cell under their new cell too:
+		uint32_t cell = grid.cell(flock.pos(s));
+		if(cell != stray_cell[s]){
+			stray_cell[s] = cell;
+			strays.emplace_back(Stray{s, cell, stray_head[cell]});
+			stray_head[cell] = strays.size()-1;
+		}
+	}
+}
+
+void World::sort_and_sweep(){
+	uint32_t count = flock.size();
+	if(sap_order.size() != count){
+		sap_order.resize(count);
+		for(uint32_t i=0;i<count;i++) sap_order[i] = i;
+	}
+	sap_x.resize(count);
+	for(uint32_t k=0;k<count;k++) sap_x[k] = flock.x[sap_order[k]];
+	//sheep barely move between steps, so last step's order is nearly sorted already:
+	for(uint32_t k=1;k<count;k++){
+		float key = sap_x[k];
+		uint32_t sheep = sap_order[k];
+		uint32_t m = k;
+		while(m > 0 && sap_x[m-1] > key){
+			sap_x[m] = sap_x[m-1];
+			sap_order[m] = sap_order[m-1];
+			m -= 1;
+		}
+		sap_x[m] = key;
+		sap_order[m] = sheep;
+	}
+	sap_rank.resize(count);
+	for(uint32_t k=0;k<count;k++) sap_rank[sap_order[k]] = k;
+}
+
+bool World::advance_range(uint32_t begin, uint32_t end, float elapsed){
+	//everything here only reads/writes sheep in [begin,end), so ranges can run in parallel:
+	uint32_t count = end - begin;
+	float *x = flock.x.data() + begin, *y = flock.y.data() + begin;
+	uint8_t *dir = flock.dir.data() + begin;
+
+	//remember where sheep started when steps are long enough to skip past things:
+	if(sweep_obstacles || sweep_sheep || sweep_dog){
+		std::copy(x, x + count, start_x.begin() + begin);
+		std::copy(y, y + count, start_y.begin() + begin);
+	}
+
+	//update sheep pos
+	float travel = speed * elapsed;
+	for(uint32_t i=0;i<count;i++){
+		x[i] += Flock::dir_x(dir[i]) * travel;
+		y[i] += Flock::dir_y(dir[i]) * travel;
+	}
+
+	//sheep/obstacle collision (fences end the game, rocks turn sheep around)
+	bool hit = false;
+	{
+		uint8_t *touch = touched.data() + begin;
+		std::fill(touch, touch + count, 0);
+		obstacles.overlaps(x, y, count, radius, touch);
+		if(sweep_obstacles){
+			std::vector< uint32_t > near;
+			glm::vec2 half = glm::vec2(radius,radius);
+			for(uint32_t i=0;i<count;i++){
+				glm::vec2 from = glm::vec2(start_x[begin+i],start_y[begin+i]), to = glm::vec2(x[i],y[i]);
+				near.clear();
+				obstacles.query(glm::min(from,to) - half, glm::max(from,to) + half, &near);
+				for(uint32_t b : near){
+					Obstacles::Box const &box = obstacles.boxes[b];
+					if(sweep_overlaps(from, to, half, box.min, box.max)) touch[i] |= uint8_t(1 << box.kind);
+				}
+			}
+		}
+		for(uint32_t i=0;i<count;i++){
+			hit |= (touch[i] >> Obstacles::Fence) & 1;
+			if((touch[i] >> Obstacles::Rock) & 1){
+				//back to where it was, facing the other way:
+				x[i] -= Flock::dir_x(dir[i]) * travel;
+				y[i] -= Flock::dir_y(dir[i]) * travel;
+				dir[i] ^= 1;
+			}
+		}
+	}
+
+	//bin for sheep/sheep collision:
+	if(broadphase == UniformGrid){
+		for(uint32_t i=begin;i<end;i++) cells[i] = grid.cell(flock.pos(i));
+	}
+
+	return hit;
+}
+
+bool World::sweep_hits(uint32_t i, uint32_t j) const {
+	//does sheep i, moving from its start relative to sheep j, pass over sheep j's start?
+	glm::vec2 from_i = glm::vec2(start_x[i],start_y[i]), from_j = glm::vec2(start_x[j],start_y[j]);
+	glm::vec2 moved = (flock.pos(i) - from_i) - (flock.pos(j) - from_j);
+	return sweep_overlaps(from_i, from_i + moved, glm::vec2(2*radius,2*radius), from_j, from_j);
+}
+
+void World::step(float elapsed, glm::vec2 const *dog_pos, uint32_t dog_count){
+	dogs_from = dogs;
+	dogs.assign(dog_pos, dog_pos + dog_count); //update dog poses
+	//(dogs that just joined start where they are)
+	for(uint32_t d=uint32_t(dogs_from.size());d<dog_count;d++) dogs_from.emplace_back(dogs[d]);
+	total_time += elapsed;
+	tick += 1;
+
+	//a sheep can only skip clean over a box if it travels further than the box and itself are wide,
+	// so swept tests only run for steps (or dog jumps) that long:
+	float travel = speed * elapsed;
+	glm::vec2 dog_jump = glm::vec2(0.0f);
+	for(uint32_t d=0;d<dog_count;d++) dog_jump = glm::max(dog_jump, glm::abs(dogs[d] - dogs_from[d]));
+	sweep_obstacles = travel >= obstacles.thinnest + 2*radius;
+	sweep_sheep = 2*travel >= 4*radius;
+	sweep_dog = std::max(dog_jump.x,dog_jump.y) + travel >= 2*(1.0f+DOG_SCALE)*radius;
+
+	uint32_t count = flock.size();
+	glm::vec2 corner = glm::vec2(FENCE_BOUND+FENCE_RAD,FENCE_BOUND+FENCE_RAD);
+	glm::vec2 lo = (obstacles.boxes.empty() ? -corner : obstacles.min), hi = (obstacles.boxes.empty() ? corner : obstacles.max);
+
+	if(herding) herd(lo, hi);
+
+	//sheep only interact with the sheep before them in sheep/sheep collision,
+	// so moving and obstacle/dog testing everyone first gives the same result as doing it sheep-by-sheep.
+	//grid: bin sheep into cells big enough that overlapping sheep are always in neighbouring cells:
+	//(when sweeping, sheep can meet from up to two steps' travel further apart)
+	grid.reset(lo, hi, 2*radius + (sweep_sheep ? 2*travel : 0.0f));
+	if(sweep_obstacles || sweep_sheep || sweep_dog){
+		start_x.resize(count);
+		start_y.resize(count);
+	}
+	cells.resize(count);
+	touched.resize(count);
+	if(pool && pool->size() > 1){
+		uint32_t chunks = (count+WORLD_GRAIN-1)/WORLD_GRAIN;
+		chunk_hits.assign(chunks, 0);
+		pool->parallel_for(count, WORLD_GRAIN, [this,elapsed](uint32_t begin, uint32_t end){
+			chunk_hits[begin/WORLD_GRAIN] = advance_range(begin, end, elapsed);
+		});
+		for(uint8_t hit : chunk_hits) if(hit) game_over = true;
+	}else{
+		if(advance_range(0, count, elapsed)) game_over = true;
+	}
+	if(broadphase == UniformGrid){
+		grid.build(cells);
+		//bouncing rewinds sheep after they are binned; any that leave their cell are also filed under their new cell:
+		for(Stray const &s : strays) stray_head[s.cell] = -1;
+		strays.clear();
+		stray_head.resize(grid.size.x*grid.size.y, -1);
+		stray_cell = cells;
+	}else if(broadphase == SortAndSweep){
+		//(when sweeping, sheep can meet from up to two steps' travel further apart)
+		sap_reach = 2*radius + (sweep_sheep ? 2*travel : 0.0f);
+		sort_and_sweep();
+	}
+	bounces.assign(count, 0);
+	rewinds = 0;
+	rewind_travel = travel * 1.001f; //a hair extra for rounding
+
+	//sheep/dog collision, looked up in the sheep broadphase:
+	touch_dogs(travel);
+
+	//sheep due to switch direction, as of this step:
+	if(scheduled != count) reschedule();
+	due.clear();
+	switches.advance(total_time, &due);
+	uint32_t kept = 0;
+	for(uint32_t s : due){
+		if(total_time - flock.switched_at[s] > SHEEP_RESET_TIME) due[kept++] = s;
+		else switches.insert(s, flock.switched_at[s] + SHEEP_RESET_TIME); //(shared a slot with the deadline; try again next step)
+	}
+	due.resize(kept);
+	std::sort(due.begin(), due.end());
+
+	if(contacts == Colored){
+		find_contacts();
+		solve_contacts(elapsed);
+		//(switches override this step's bounces, as in the ordered pass)
+		for(uint32_t s : due) switch_direction(s);
+	}else{ //Ordered
+		uint32_t next_due = 0;
+		for(uint32_t i=0;i<count;i++){
+			//sheep/sheep collision, against earlier sheep in index order (as the all-pairs loop did):
+			gather_candidates(i, 0);
+			for(uint32_t k=0;k<candidates.size();k++){
+				uint32_t j = candidates[k];
+				if(!flock.collision(i, j, radius) && !(sweep_sheep && sweep_hits(i, j))) continue;
+				bounce(flock, i, j, speed, elapsed);
+				note_bounced(i);
+				note_bounced(j);
+				//if this sheep was pushed out of where it looked, look again from here for the rest:
+				bool moved = (broadphase == UniformGrid ? grid.cell(flock.pos(i)) != gathered_cell : flock.x[i] != gathered_x);
+				if(moved){
+					gather_candidates(i, j+1);
+					k = -1U;
+				}
+			}
+
+			//INTRODUCE MOVEMENT RANDOMNESS PERIODICALLY
+			//(after this sheep's bounces, which it overrides)
+			if(next_due < due.size() && due[next_due] == i){
+				switch_direction(i);
+				next_due += 1;
+			}
+		}
+	}
+
+	speed += elapsed*SPEEDUP; //sheep speed increases over time
+}
+
+void World::herd(glm::vec2 const &lo, glm::vec2 const &hi){
+	//everyone decides from where the flock stands at the start of the step, so sheep can decide in parallel.
+	//everything per-sheep is kept in neighbors' slot order, so sheep next to each other in memory share neighbours:
+	uint32_t count = flock.size();
+	neighbors.build(flock.x.data(), flock.y.data(), count, lo, hi, HERD_RANGE*radius);
+	herd_vx.resize(count);
+	herd_vy.resize(count);
+	for(uint32_t k=0;k<count;k++){
+		uint8_t d = flock.dir[neighbors.grid.items[k]];
+		herd_vx[k] = Flock::dir_x(d);
+		herd_vy[k] = Flock::dir_y(d);
+	}
+
+	//dogs are few, so each one looks up the sheep it scares (rather than every sheep checking every dog):
+	float flee_range = HERD_FLEE_RANGE*radius;
+	flee_x.assign(count, 0.0f);
+	flee_y.assign(count, 0.0f);
+	for(glm::vec2 const &dog : dogs){
+		dog_near.clear();
+		neighbors.within(dog, flee_range, &dog_near);
+		for(uint32_t k : dog_near){
+			glm::vec2 away = glm::vec2(neighbors.x[k],neighbors.y[k]) - dog;
+			float dist = glm::length(away);
+			if(dist == 0.0f) continue;
+			float urge = (1.0f - dist / flee_range) / dist; //stronger closer in
+			flee_x[k] += away.x * urge;
+			flee_y[k] += away.y * urge;
+		}
+	}
+
+	if(pool && pool->size() > 1){
+		chunk_near.resize((count+WORLD_GRAIN-1)/WORLD_GRAIN);
+		pool->parallel_for(count, WORLD_GRAIN, [this](uint32_t begin, uint32_t end){
+			herd_range(begin, end, &chunk_near[begin/WORLD_GRAIN]);
+		});
+	}else{
+		chunk_near.resize(1);
+		herd_range(0, count, &chunk_near[0]);
+	}
+}
+
+void World::herd_range(uint32_t begin, uint32_t end, std::vector< uint32_t > *near){
+	//only writes the directions of the sheep in slots [begin,end):
+	float range = HERD_RANGE*radius, personal = HERD_PERSONAL_RANGE*radius;
+	float personal2 = personal*personal;
+	float const *nx = neighbors.x.data(), *ny = neighbors.y.data();
+	for(uint32_t s=begin;s<end;s++){
+		float px = nx[s], py = ny[s];
+		near->clear();
+		neighbors.within(glm::vec2(px,py), range, near);
+		float seen = 0.0f, close = 0.0f, sep_x = 0.0f, sep_y = 0.0f, align_x = 0.0f, align_y = 0.0f, coh_x = 0.0f, coh_y = 0.0f;
+		for(uint32_t k : *near){
+			float dx = nx[k] - px, dy = ny[k] - py;
+			float in = (k != s ? 1.0f : 0.0f);
+			float crowd = (dx*dx + dy*dy < personal2 ? in : 0.0f);
+			seen += in;
+			close += crowd;
+			sep_x -= crowd * dx;
+			sep_y -= crowd * dy;
+			align_x += in * herd_vx[k];
+			align_y += in * herd_vy[k];
+			coh_x += in * dx;
+			coh_y += in * dy;
+		}
+
+		glm::vec2 want = HERD_FLEE*glm::vec2(flee_x[s],flee_y[s]);
+		if(close > 0.0f) want += (HERD_SEPARATION/personal) * glm::vec2(sep_x,sep_y);
+		if(seen > 0.0f){
+			want += (HERD_ALIGNMENT/seen) * glm::vec2(align_x,align_y);
+			want += (HERD_COHESION/(seen*range)) * glm::vec2(coh_x,coh_y);
+		}
+
+		//sheep still only walk NSEW; turn to the best of the four if it's enough better than the current one:
+		uint8_t best;
+		if(fabsf(want.x) >= fabsf(want.y)) best = (want.x >= 0.0f ? Flock::Right : Flock::Left);
+		else best = (want.y >= 0.0f ? Flock::Up : Flock::Down);
+		float gain = glm::dot(want, Flock::direction_vector(best)) - glm::dot(want, glm::vec2(herd_vx[s],herd_vy[s]));
+		if(gain > HERD_THRESHOLD) flock.dir[neighbors.grid.items[s]] = best;
+	}
+}
+
+void World::touch_dogs(float travel){
+	dog_touching.clear();
+	dog_met.clear();
+	float reach = (1.0f+DOG_SCALE)*radius;
+	glm::vec2 half = DOG_SCALE*glm::vec2(radius,radius), around = glm::vec2(reach,reach), ahead = glm::vec2(travel,travel);
+	for(uint32_t d=0;d<dogs.size();d++){
+		glm::vec2 dog = dogs[d], dog_from = dogs_from[d];
+		glm::vec2 dogTL = dog - half, dogBL = dog + half;
+		//sheep that could touch the dog (or, when sweeping, meet it anywhere along the way):
+		glm::vec2 lo = dog - around, hi = dog + around;
+		if(sweep_dog){
+			lo = glm::min(dog, dog_from) - around - ahead;
+			hi = glm::max(dog, dog_from) + around + ahead;
+		}
+		dog_near.clear();
+		if(broadphase == UniformGrid){
+			glm::ivec2 c0 = grid.coords(lo), c1 = grid.coords(hi);
+			for(int y=c0.y;y<=c1.y;y++){
+				for(int x=c0.x;x<=c1.x;x++){
+					uint32_t c = y*grid.size.x+x;
+					dog_near.insert(dog_near.end(), grid.items.begin() + grid.starts[c], grid.items.begin() + grid.starts[c+1]);
+				}
+			}
+		}else if(broadphase == SortAndSweep){
+			for(uint32_t k=uint32_t(std::lower_bound(sap_x.begin(), sap_x.end(), lo.x) - sap_x.begin());k<sap_x.size() && sap_x[k] <= hi.x;k++){
+				dog_near.emplace_back(sap_order[k]);
+			}
+		}else{ //AllPairs
+			for(uint32_t s=0;s<flock.size();s++) dog_near.emplace_back(s);
+		}
+
+		for(uint32_t s : dog_near){
+			bool touch = flock.collision(s, dogTL, dogBL, radius);
+			bool met = touch;
+			if(sweep_dog && !touch){
+				//did the dog pass over the sheep on the way? (watching from the sheep's start)
+				glm::vec2 from = glm::vec2(start_x[s],start_y[s]);
+				glm::vec2 moved = flock.pos(s) - from;
+				met = sweep_overlaps(dog_from, dog - moved, around, from, from);
+			}
+			if(touch) dog_touching.emplace_back(dog_contact(s, d));
+			if(met) dog_met.emplace_back(dog_contact(s, d));
+		}
+	}
+	std::sort(dog_touching.begin(), dog_touching.end());
+	std::sort(dog_met.begin(), dog_met.end());
+
+	//only flip velocity if just collided (with any dog; once per sheep):
+	uint32_t flipped = -1U;
+	for(uint64_t pair : dog_met){
+		uint32_t s = uint32_t(pair >> 32);
+		if(s == flipped || std::binary_search(dog_contacts.begin(), dog_contacts.end(), pair)) continue;
+		flock.flip(s);
+		flipped = s;
+	}
+	dog_contacts.swap(dog_touching);
+}
+
+std::vector< uint8_t > World::dog_touches(uint32_t dog) const {
+	std::vector< uint8_t > touches(flock.size(), 0);
+	for(uint64_t pair : dog_contacts){
+		if(uint32_t(pair) == dog) touches[pair >> 32] = 1;
+	}
+	return touches;
+}
+
+void World::switch_direction(uint32_t s){
+	//set random direction
+	flock.dir[s] = random_direction(seed, s, tick);
+	flock.switched_at[s] = total_time;
+	switches.insert(s, total_time + SHEEP_RESET_TIME);
+}
+
+void World::find_contacts(){
+	//phase one: every overlapping pair, before anyone bounces (so chunks can look in parallel):
+	uint32_t count = flock.size();
+	uint32_t chunks = (count+WORLD_GRAIN-1)/WORLD_GRAIN;
+	chunk_contacts.resize(chunks);
+	chunk_candidates.resize(chunks);
+	auto find = [this](uint32_t begin, uint32_t end){
+		std::vector< Contact > &found = chunk_contacts[begin/WORLD_GRAIN];
+		std::vector< uint32_t > &near = chunk_candidates[begin/WORLD_GRAIN];
+		found.clear();
+		for(uint32_t i=begin;i<end;i++){
+			gather_candidates(i, 0, &near);
+			for(uint32_t j : near){
+				if(flock.collision(i, j, radius) || (sweep_sheep && sweep_hits(i, j))) found.emplace_back(Contact{i, j});
+			}
+		}
+	};
+	if(pool && pool->size() > 1){
+		pool->parallel_for(count, WORLD_GRAIN, find);
+	}else{
+		for(uint32_t begin=0;begin<count;begin+=WORLD_GRAIN) find(begin, std::min(count, begin+WORLD_GRAIN));
+	}
+
+	//greedy coloring, in found order (so the batches don't depend on thread count):
+	//each contact takes the first color neither of its sheep has yet; color 64 is the overflow
+	colors_used.resize(count, 0);
+	contact_colors.clear();
+	color_starts.assign(65+1, 0);
+	for(auto const &found : chunk_contacts){
+		for(Contact const &c : found){
+			uint64_t used = colors_used[c.a] | colors_used[c.b];
+			uint32_t color = 0;
+			while(color < 64 && ((used >> color) & 1)) color += 1;
+			if(color < 64){
+				colors_used[c.a] |= uint64_t(1) << color;
+				colors_used[c.b] |= uint64_t(1) << color;
+			}
+			contact_colors.emplace_back(uint8_t(color));
+			color_starts[color+1] += 1;
+		}
+	}
+	for(uint32_t c=0;c<65;c++) color_starts[c+1] += color_starts[c];
+
+	//group by color:
+	contact_list.resize(color_starts.back());
+	std::vector< uint32_t > fill(color_starts.begin(), color_starts.end() - 1);
+	uint32_t k = 0;
+	for(auto const &found : chunk_contacts){
+		for(Contact const &c : found){
+			contact_list[fill[contact_colors[k++]]++] = c;
+			colors_used[c.a] = 0;
+			colors_used[c.b] = 0;
+		}
+	}
+}
+
+void World::solve_contacts(float elapsed){
+	//phase two: colors in order; contacts of one color share no sheep, so they bounce in parallel:
+	auto resolve = [this,elapsed](uint32_t begin, uint32_t end){
+		for(uint32_t k=begin;k<end;k++){
+			Contact const &c = contact_list[k];
+			//an earlier color may have bounced these two apart already:
+			if(!flock.collision(c.a, c.b, radius) && !(sweep_sheep && sweep_hits(c.a, c.b))) continue;
+			bounce(flock, c.a, c.b, speed, elapsed);
+		}
+	};
+	for(uint32_t color=0;color<65;color++){
+		uint32_t begin = color_starts[color], end = color_starts[color+1];
+		if(color < 64 && pool && pool->size() > 1){
+			pool->parallel_for(end - begin, WORLD_GRAIN / 16, [&](uint32_t b, uint32_t e){ resolve(begin + b, begin + e); });
+		}else{ //(overflow contacts may share sheep, so they go one at a time)
+			resolve(begin, end);
+		}
+	}
+}
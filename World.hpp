@@ -0,0 +1,181 @@
+#pragma once
+/*
+ * World holds the sheep game simulation, independent of any window or GL context.
+ *
+ * All positions use the same [-1,1] x [-1,1] coordinates as Draw.
+ *
+ * Example:
+ * //advance the game by one 60Hz frame with the dog at the origin:
+ *   World world;
+ *   world.step(1.0f / 60.0f, glm::vec2(0.0f, 0.0f));
+ *   if (world.game_over) { ... }
+ */
+
+#include "Flock.hpp"
+#include "Grid.hpp"
+#include "Neighbors.hpp"
+#include "Obstacles.hpp"
+#include "TimingWheel.hpp"
+#include "WorldState.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+//GAME PARAMETERS
+#define SHEEP_COUNT 5
+#define DOG_SCALE 1.f //as compared to sheep
+#define SPEEDUP 0.001f
+#define FENCE_BOUND 0.8f
+#define FENCE_RAD 0.025f
+#define SHEEP_RESET_TIME 10.f //change sheep directions periodically
+
+//herding (see World::herding); ranges are in sheep radii:
+#define HERD_RANGE 8.f //how far sheep notice each other
+#define HERD_FLEE_RANGE 12.f //how far sheep notice dogs
+#define HERD_PERSONAL_RANGE 4.f //how close neighbours get before sheep want space
+#define HERD_SEPARATION 1.f //urge to keep off close neighbours
+#define HERD_ALIGNMENT 0.5f //urge to walk the way neighbours walk
+#define HERD_COHESION 1.f //urge to walk toward neighbours
+#define HERD_FLEE 4.f //urge to walk away from dogs
+#define HERD_THRESHOLD 0.5f //how much better a direction must be before a sheep turns to it
+
+#define WORLD_GRAIN 4096 //sheep per parallel chunk (keep a multiple of 16)
+
+struct ThreadPool;
+
+bool close_enough(float x, float y); //float equality function
+
+struct World {
+	//place 'count' sheep in a ring around the center, each with a random NSEW direction drawn from 'seed':
+	World(int count = SHEEP_COUNT, uint32_t seed = 0);
+
+	//advance the game by 'elapsed' seconds, with the (first) dog moved to 'dog_pos':
+	void step(float elapsed, glm::vec2 const &dog_pos) { step(elapsed, &dog_pos, 1); }
+	//...with 'dog_count' dogs moved to dog_pos[0 .. dog_count) (e.g. the player's dog, then scripted ones):
+	void step(float elapsed, glm::vec2 const *dog_pos, uint32_t dog_count);
+
+	//rebuild the switch schedule from flock.switched_at (call after changing it outside of step()):
+	void reschedule();
+
+	//save everything step() carries over into 'out' (reusing its memory), or put it back:
+	void snapshot(WorldState *out) const;
+	void restore(WorldState const &state);
+	//a new world in the same state, with the same settings and obstacles (but none of the caches):
+	World fork() const;
+
+	//if set, step() splits per-sheep work across this pool (results are identical either way):
+	ThreadPool *pool = nullptr;
+
+	//how step() finds sheep/sheep pairs to test (results are identical either way):
+	enum Broadphase : uint8_t {
+		UniformGrid, //bin into cells every step
+		SortAndSweep, //keep sheep sorted by x between steps
+		AllPairs, //every earlier sheep is a candidate (slow; the reference the others are checked against)
+	} broadphase = UniformGrid;
+
+	//how step() resolves sheep/sheep contacts:
+	enum Contacts : uint8_t {
+		Ordered, //one sheep at a time in index order, each bounce seeing the ones before it (as the all-pairs loop did)
+		Colored, //find every contact first, then bounce batches of contacts that share no sheep in parallel
+	} contacts = Ordered;
+
+	//boids-style herding (separation, alignment, cohesion, fleeing dogs), decided at the start of each step:
+	bool herding = false;
+
+	Flock flock;
+	float speed = 0.05f; //all sheep have same speed
+	float radius = 0.1f; //all sheep are the same size
+	std::vector< glm::vec2 > dogs; //[0] is the player's dog
+
+	//Out of Bounds
+	glm::vec2 boundaries[4];
+	glm::vec2 fence_pad;
+	//fences and rocks; starts as the four-sided pen around 'boundaries' (load() a level to replace it):
+	Obstacles obstacles;
+
+	uint32_t seed; //all randomness is rng_u32(seed, sheep, tick) (see Rng.hpp)
+	uint32_t tick = 0; //steps taken so far
+
+	float total_time = 0; //keep track to tell user their score at the end
+	bool game_over = false; //set once a sheep touches the fence
+
+	//----- internals -----
+	//swept tests, for steps long enough to skip past things:
+	bool sweep_obstacles = false, sweep_sheep = false, sweep_dog = false;
+	std::vector< float > start_x, start_y; //sheep positions at the start of the step (when sweeping)
+	std::vector< glm::vec2 > dogs_from; //dog positions at the start of the step
+	bool sweep_hits(uint32_t i, uint32_t j) const;
+	std::vector< uint8_t > touched; //per-sheep Obstacles kinds touched this step
+	std::vector< uint8_t > chunk_hits; //per-chunk fence hits when running on 'pool'
+	//move, obstacle-test, and bin sheep [begin,end); returns true if any hit the fence:
+	bool advance_range(uint32_t begin, uint32_t end, float elapsed);
+
+	//uniform grid broadphase, rebuilt every step:
+	Grid grid;
+	std::vector< uint32_t > cells; //cell each sheep was binned into
+	//sheep bounced out of their binned cell this step, as per-cell lists (stale entries are harmless):
+	struct Stray {
+		uint32_t sheep;
+		uint32_t cell;
+		int32_t next; //next Stray in the same cell, or -1
+	};
+	std::vector< Stray > strays;
+	std::vector< int32_t > stray_head; //per-cell first Stray, or -1
+	std::vector< uint32_t > stray_cell; //per-sheep cell it was last filed under
+	//each bounce rewinds a sheep by up to one step's travel, so broadphases widen their scans by the most any sheep has bounced:
+	std::vector< uint32_t > bounces; //per-sheep bounces since binning (or sorting)
+	uint32_t rewinds = 0; //most bounces any sheep has had since binning (or sorting)
+	float rewind_travel = 0.0f; //how far one bounce can move a sheep
+	//sort-and-sweep broadphase, kept between steps:
+	std::vector< uint32_t > sap_order; //sheep sorted by x
+	std::vector< float > sap_x; //x of sap_order[k] when sorted
+	std::vector< uint32_t > sap_rank; //per-sheep index into sap_order
+	float sap_reach = 0.0f;
+	void sort_and_sweep();
+
+	//periodic direction switches, so only sheep that are due get looked at:
+	TimingWheel switches = TimingWheel(1.0f / 64.0f, SHEEP_RESET_TIME + 1.0f);
+	uint32_t scheduled = 0; //sheep in 'switches'
+	std::vector< uint32_t > due; //sheep switching this step, ascending
+
+	std::vector< uint32_t > candidates;
+	uint32_t gathered_cell = 0; //where sheep i was when candidates were gathered
+	float gathered_x = 0.0f;
+	void gather_candidates(uint32_t i, uint32_t begin); //into 'candidates', noting where sheep i was
+	void gather_candidates(uint32_t i, uint32_t begin, std::vector< uint32_t > *out) const;
+	void note_bounced(uint32_t s);
+	void switch_direction(uint32_t s);
+
+	//herding: sheep see each other through a neighbour grid rebuilt each step:
+	Neighbors neighbors;
+	std::vector< float > herd_vx, herd_vy; //sheep velocities, in neighbors' slot order
+	std::vector< float > flee_x, flee_y; //urge away from nearby dogs, in slot order
+	void herd(glm::vec2 const &lo, glm::vec2 const &hi); //turn sheep toward what their neighbours and the dogs make them want
+	std::vector< std::vector< uint32_t > > chunk_near; //per-chunk query results
+	void herd_range(uint32_t begin, uint32_t end, std::vector< uint32_t > *near); //...for the sheep in slots [begin,end)
+
+	//per-sheep 1/0: is dog 'dog' overlapping the sheep (as of the last step):
+	std::vector< uint8_t > dog_touches(uint32_t dog) const;
+
+	//dog/sheep contacts, found through the sheep broadphase and kept as sorted pair lists (not a dogs x sheep table):
+	static uint64_t dog_contact(uint32_t sheep, uint32_t dog) { return (uint64_t(sheep) << 32) | dog; }
+	std::vector< uint64_t > dog_contacts; //dog_contact()s overlapping as of the last step, ascending
+	std::vector< uint64_t > dog_touching, dog_met; //this step's overlaps, and those plus swept meetings
+	std::vector< uint32_t > dog_near; //scratch
+	void touch_dogs(float travel); //flip sheep that any dog newly met
+
+	//two-phase contacts (Colored):
+	struct Contact {
+		uint32_t a, b; //sheep, a > b
+	};
+	std::vector< std::vector< Contact > > chunk_contacts; //per-chunk contacts found
+	std::vector< std::vector< uint32_t > > chunk_candidates; //per-chunk gather_candidates() scratch
+	std::vector< uint8_t > contact_colors; //per-contact color, in found order
+	std::vector< uint64_t > colors_used; //per-sheep colors its contacts have so far (zero between steps)
+	std::vector< Contact > contact_list; //contacts grouped by color
+	std::vector< uint32_t > color_starts; //color c is contact_list[color_starts[c]] ... contact_list[color_starts[c+1]-1]
+	void find_contacts();
+	void solve_contacts(float elapsed);
+};
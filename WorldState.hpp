@@ -0,0 +1,42 @@
+#pragma once
+/*
+ * WorldState is everything World::step() carries from one step to the next -- sheep, dogs,
+ * speed, clock, and random seed -- packed back to back in one block, so saving, restoring,
+ * and copying a game are a handful of memcpys (and copying a WorldState is one).
+ *
+ * Settings (broadphase, contacts, herding, thread pool) and the level's obstacles are not
+ * part of it; they belong to the World a state is restored into. Caches (grids, the switch
+ * schedule) are rebuilt from the state, so stepping on gives exactly the same results.
+ *
+ * Example:
+ *   WorldState saved;
+ *   world.snapshot(&saved);
+ *   for (...) world.step(...); //look ahead...
+ *   world.restore(saved); //...and rewind
+ *   World what_if = world.fork(); //or try something else on the side
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+struct WorldState {
+	struct Header {
+		uint32_t sheep, dogs, dog_contacts; //counts of what follows
+		uint32_t seed, tick;
+		float speed, radius, total_time;
+		uint32_t game_over;
+		uint32_t pad;
+	};
+	static_assert(sizeof(Header) % 8 == 0, "Header should keep the sections after it 8-byte aligned");
+
+	//the header, then sheep x, y, switched_at, dir, then dogs, then dog contacts; each section padded to 8 bytes:
+	std::vector< uint64_t > block;
+
+	Header header() const {
+		Header h;
+		std::memcpy(&h, block.data(), sizeof(h));
+		return h;
+	}
+	size_t bytes() const { return block.size() * sizeof(uint64_t); }
+};
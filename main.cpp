@@ -1,73 +1,47 @@
 #include "Draw.hpp"
 #include "GL.hpp"
+#include "World.hpp"
+#include "FixedStep.hpp"
+#include "InputLog.hpp"
 
 #include <SDL.h>
 #include <glm/glm.hpp>
 
 #include <chrono>
 #include <iostream>
-#include <stdlib.h> //used for random
 #include <time.h> //used for random seed
-#include <math.h> //used for sheep positioning
 
-bool close_enough(float x, float y){ //float equality function
-	float absdif = x-y;
-	if(absdif<0) return absdif >= -0.00001f;
-	else         return absdif <=  0.00001f;
-}
-
-class Sheep {
-public:
-	static float speed; //all sheep have same speed
-	static float radius; //all sheep are the same size
-	static glm::u8vec4 color; //all sheep have the same color
-
-	glm::vec2 pos,vel; //different pos & vel
-	bool dogCollide; //true when dog is overlapping sheep so no infinite flipping occurs
-	float lastSwitch; //time since last directional switch. Used to add randomness
-	Sheep(){}
-	Sheep(glm::vec2 pos, glm::vec2 vel){
-		this->pos = pos;
-		this->vel = vel;
-		dogCollide = false;
-		lastSwitch = 0;
-	}
-	bool collision(Sheep other){
-		//tl stands for top-left corner
-		glm::vec2 tl1 = this->pos - glm::vec2(radius,radius),
-		          tl2 = other.pos - glm::vec2(radius,radius);
-		return tl1.x < tl2.x + 2*radius && tl1.x + 2*radius > tl2.x &&
-		       tl1.y < tl2.y + 2*radius && tl1.y + 2*radius > tl2.y;
-	}
-	bool collision(glm::vec2 tl2,glm::vec2 bl2){ //used for dog and fence collision
-		//tl stands for top-left corner, bl stands for bottom-left corner
-		glm::vec2 tl1 = this->pos - glm::vec2(radius,radius);
-		return tl1.x < bl2.x && tl1.x + 2*radius > tl2.x &&
-		       tl1.y < bl2.y && tl1.y + 2*radius > tl2.y;
-	}
-};
-
-//GAME PARAMETERS
-glm::u8vec4 Sheep::color = glm::u8vec4(0xff,0xff,0xff,0xff); //white
-float Sheep::speed = 0.05f;
-float Sheep::radius = 0.1f;
-#define SHEEP_COUNT 5
-#define DOG_SCALE 1.f //as compared to sheep
+//RENDER PARAMETERS
+#define SHEEP_COLOR glm::u8vec4(0xff,0xff,0xff,0xff) //white
 #define DOG_COLOR glm::u8vec4(0x00,0x00,0x00,0xff) //black
 #define FENCE_COLOR glm::u8vec4(0xa7,0x71,0x50,0xff) //brown
+#define ROCK_COLOR glm::u8vec4(0x80,0x80,0x80,0xff) //gray
 #define GROUND_COLOR_HACK 0,1,0,1 //I'm so sorry. Green
-#define SPEEDUP 0.001f
-#define FENCE_BOUND 0.8f
-#define FENCE_RAD 0.025f
-#define SHEEP_RESET_TIME 10.f //change sheep directions periodically
 
 int main(int argc, char **argv) {
 	//Configuration:
 	struct {
 		std::string title = "Game0: Sheep Herder";
 		glm::uvec2 size = glm::uvec2(640, 640); //square
+		float tick_rate = 120.0f; //simulation steps per second
+		uint32_t max_steps = 8; //most steps to catch up in one frame
+		uint32_t scripted_dogs = 0; //extra dogs that circle the pen on their own
+		bool herding = false; //sheep flock together and flee dogs (see World::herding)
+		Draw::Format draw_format = Draw::Palette; //how rectangles are sent to the GPU each frame (see Draw.hpp)
+		std::string level; //level file with fences and rocks (see Obstacles.hpp)
+		std::string record; //save the session's input here, for ./sim_bench --replay (see InputLog.hpp)
 	} config;
 
+	//usage: ./main [level] [--record FILE]
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--record" && i + 1 < argc) {
+			config.record = argv[++i];
+		} else {
+			config.level = arg;
+		}
+	}
+
 	//------------  initialization ------------
 
 	//Initialize SDL library:
@@ -129,46 +103,40 @@ int main(int argc, char **argv) {
 	SDL_ShowCursor(SDL_DISABLE);
 
 	//------------  game state ------------
-	srand(time(NULL)); //random seed
 	bool paused = true; //can pause game with 'p' key
-	float total_time = 0; //keep track to tell user their score at the end
-
-	//initialize sheep
-	Sheep sheeps[SHEEP_COUNT];
-	for(int i=0;i<SHEEP_COUNT;i++){
-		//set sheep position
-		float angle = 2*3.14159265f/SHEEP_COUNT*i;
-		glm::vec2 pos = 0.3f*glm::vec2(sin(angle),cos(angle));
-		
-		//set random direction
-		int randdir = rand() % 4;
-		switch(randdir){ //can only go north, south, east, or west
-		case 0: //right
-			sheeps[i] = Sheep(pos,glm::vec2(1,0));
-			break;
-		case 1: //left
-			sheeps[i] = Sheep(pos,glm::vec2(-1,0));
-			break;
-		case 2: //up
-			sheeps[i] = Sheep(pos,glm::vec2(0,1));
-			break;
-		default: //down
-			sheeps[i] = Sheep(pos,glm::vec2(0,-1));
-			break;
-		}
-	}
 
-	//dog
-	glm::vec2 dog = glm::vec2(FENCE_BOUND-FENCE_RAD-DOG_SCALE*Sheep::radius,-FENCE_BOUND+FENCE_RAD+DOG_SCALE*Sheep::radius);
-	glm::vec2 mouse = glm::vec2(0.0f, 0.0f);
+	//everything the game starts from goes in the log, so the session can be replayed:
+	InputLog log;
+	log.seed = uint32_t(time(NULL)); //(randomly seeded)
+	log.tick_rate = config.tick_rate;
+	log.size = config.size;
+	log.scripted_dogs = config.scripted_dogs;
+	log.herding = config.herding;
+	log.level = config.level;
+	World world;
+	try {
+		world = log.start(); //sheep, dog, and fence (throws if the level file can't be read)
+	} catch (std::exception &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		SDL_GL_DeleteContext(context);
+		SDL_DestroyWindow(window);
+		return 1;
+	}
+	FixedStep fixed(config.tick_rate, config.max_steps);
+	//state before the most recent step, so drawing can blend toward the current one:
+	std::vector< float > previous_x = world.flock.x, previous_y = world.flock.y;
+	std::vector< glm::vec2 > previous_dogs = world.dogs;
+	std::vector< glm::vec2 > dogs; //[0] follows the mouse
+
+	//out of bounds (and rocks) never move, so they are drawn from a layer built once:
+	DrawLayer scenery;
+	for(Obstacles::Box const &box : world.obstacles.boxes){
+		scenery.add_rectangle(box.min,box.max,(box.kind == Obstacles::Fence ? FENCE_COLOR : ROCK_COLOR));
+	}
+	Draw draw(config.draw_format); //(kept between frames, so its command list isn't reallocated every frame)
 
-	//Out of Bounds
-	glm::vec2 boundaries[4];
-	boundaries[0] = glm::vec2(-FENCE_BOUND,FENCE_BOUND);
-	boundaries[1] = glm::vec2(FENCE_BOUND,FENCE_BOUND);
-	boundaries[2] = glm::vec2(FENCE_BOUND,-FENCE_BOUND);
-	boundaries[3] = glm::vec2(-FENCE_BOUND,-FENCE_BOUND);
-	glm::vec2 fence_pad = glm::vec2(FENCE_RAD,FENCE_RAD);
+	glm::ivec2 mouse = glm::ivec2(config.size.x / 2, config.size.y / 2); //in window pixels
+	uint32_t pause_toggles = 0; //since the last step
 
 	//------------  game loop ------------
 
@@ -179,8 +147,7 @@ int main(int argc, char **argv) {
 		while (SDL_PollEvent(&evt) == 1) {
 			//handle input:
 			if (evt.type == SDL_MOUSEMOTION) {
-				mouse.x = (evt.motion.x + 0.5f) / float(config.size.x) * 2.0f - 1.0f;
-				mouse.y = (evt.motion.y + 0.5f) / float(config.size.y) *-2.0f + 1.0f;
+				mouse = glm::ivec2(evt.motion.x, evt.motion.y);
 			}else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_ESCAPE) { //quit game
 				should_quit = true;
 			}else if (evt.type == SDL_QUIT) {
@@ -188,6 +155,7 @@ int main(int argc, char **argv) {
 				break;
 			}else if(evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_p){ //pause game
 				paused = !paused;
+				pause_toggles += 1;
 				break;
 			}
 		}
@@ -199,97 +167,22 @@ int main(int argc, char **argv) {
 
 		{ //update game state:
 			if(!paused){
-				dog = mouse; //update dog pose
-				total_time += elapsed;
-
-				for(int i=0;i<SHEEP_COUNT;i++){
-					sheeps[i].lastSwitch += elapsed;
-					sheeps[i].pos += sheeps[i].vel * Sheep::speed * elapsed; //update sheep pos
-
-					//sheep/OOB collision
-					if(sheeps[i].collision(boundaries[0]-fence_pad,boundaries[1]+fence_pad) ||
-					   sheeps[i].collision(boundaries[2]-fence_pad,boundaries[1]+fence_pad) ||
-					   sheeps[i].collision(boundaries[3]-fence_pad,boundaries[2]+fence_pad) ||
-					   sheeps[i].collision(boundaries[3]-fence_pad,boundaries[0]+fence_pad)){
-						printf("Game over! You lasted %.2f seconds\n",total_time);
-						should_quit = true;
-					}
-
-					//sheep/dog collision
-					glm::vec2 dogTL = dog - DOG_SCALE*glm::vec2(Sheep::radius,Sheep::radius),
-					          dogBL = dog + DOG_SCALE*glm::vec2(Sheep::radius,Sheep::radius);
-					if(sheeps[i].collision(dogTL,dogBL)){
-						if(!sheeps[i].dogCollide){ //only flip velocity if just collided
-							sheeps[i].vel *= -1;
-							sheeps[i].dogCollide = true;
-						}
-					}else if(sheeps[i].dogCollide) sheeps[i].dogCollide = false;
-
-					//sheep/sheep collision
-					for(int j=0;j<i;j++){
-						if(sheeps[i].collision(sheeps[j])){
-							//get pos and vel before collision
-							glm::vec2 vel1 = sheeps[i].vel*Sheep::speed,
-							          vel2 = sheeps[j].vel*Sheep::speed;
-							glm::vec2 prev1 = sheeps[i].pos - vel1*elapsed,
-							          prev2 = sheeps[j].pos - vel2*elapsed;
-
-							//reset to pre-collision so collision only happens once
-							sheeps[i].pos = prev1;
-							sheeps[j].pos = prev2;
-
-							if(close_enough(vel1.x,-vel2.x) &&
-							   close_enough(vel1.y,-vel2.y)){
-								//direct collision
-								sheeps[i].vel *= -1;
-								sheeps[j].vel *= -1;
-							}else{ //t-bone collision
-								//calculate who gets to the collision first
-								glm::vec2 dist = prev2-prev1;
-								float time1,time2;
-								if(close_enough(vel1.x,0.f)){ //i moves in y, j moves in x
-									time1 = abs(dist.y/vel1.y);
-									time2 = abs(dist.x/vel2.x);
-								}else{ //i moves in x, j moves in y
-									time1 = abs(dist.x/vel1.x);
-									time2 = abs(dist.y/vel2.y);
-								}
-								
-								//based on collision, adjust velocities
-								if(time1 <= time2){ //sheep j 'rams' sheep i
-									sheeps[i].vel = sheeps[j].vel;
-									sheeps[j].vel *= -1;
-								}else{ //sheep i 'rams' sheep j
-									sheeps[j].vel = sheeps[i].vel;
-									sheeps[i].vel *= -1;
-								}
-							}
-						}
-					}
-
-					//INTRODUCE MOVEMENT RANDOMNESS PERIODICALLY
-					if(sheeps[i].lastSwitch > SHEEP_RESET_TIME){
-						//set random direction
-						int randdir = rand() % 4;
-						switch(randdir){ //can only go north, south, east, or west
-						case 0: //right
-							sheeps[i].vel = glm::vec2(1,0);
-							break;
-						case 1: //left
-							sheeps[i].vel = glm::vec2(-1,0);
-							break;
-						case 2: //up
-							sheeps[i].vel = glm::vec2(0,1);
-							break;
-						default: //down
-							sheeps[i].vel = glm::vec2(0,-1);
-							break;
-						}
-						sheeps[i].lastSwitch = 0;
+				uint32_t steps = fixed.advance(elapsed);
+				for(uint32_t s=0;s<steps && !world.game_over;s++){
+					if(s+1 == steps){
+						previous_x = world.flock.x;
+						previous_y = world.flock.y;
+						previous_dogs = world.dogs;
 					}
+					log.dogs(world, mouse, &dogs);
+					log.record(mouse, pause_toggles);
+					pause_toggles = 0;
+					world.step(fixed.tick, dogs.data(), uint32_t(dogs.size()));
+				}
+				if(world.game_over){
+					printf("Game over! You lasted %.2f seconds\n",world.total_time);
+					should_quit = true;
 				}
-				
-				Sheep::speed += elapsed*SPEEDUP; //sheep speed increases over time
 			}
 		}
 
@@ -299,20 +192,25 @@ int main(int argc, char **argv) {
 
 
 		{ //draw game state:
-			Draw draw;
-
-			//draw out of bounds
-			draw.add_rectangle(boundaries[0]-fence_pad,boundaries[1]+fence_pad,FENCE_COLOR);
-			draw.add_rectangle(boundaries[1]-fence_pad,boundaries[2]+fence_pad,FENCE_COLOR);
-			draw.add_rectangle(boundaries[3]-fence_pad,boundaries[2]+fence_pad,FENCE_COLOR);
-			draw.add_rectangle(boundaries[0]-fence_pad,boundaries[3]+fence_pad,FENCE_COLOR);
-
-			//draw sheep
-			glm::vec2 rad2 = glm::vec2(Sheep::radius,Sheep::radius);
-			for(int i=0;i<SHEEP_COUNT;i++)
-				draw.add_rectangle(sheeps[i].pos-rad2,sheeps[i].pos+rad2,Sheep::color);
-			//draw dog
-			draw.add_rectangle(dog-DOG_SCALE*rad2,dog+DOG_SCALE*rad2,DOG_COLOR);
+			//draw out of bounds (and rocks)
+			draw.depth = 0;
+			draw.add_layer(scenery);
+
+			//everything else goes on top
+			draw.depth = 1;
+
+			//draw sheep, blended between the last two steps
+			float alpha = fixed.alpha();
+			glm::vec2 rad2 = glm::vec2(world.radius,world.radius);
+			for(uint32_t i=0;i<world.flock.size();i++){
+				glm::vec2 pos = glm::mix(glm::vec2(previous_x[i],previous_y[i]),world.flock.pos(i),alpha);
+				draw.add_rectangle(pos-rad2,pos+rad2,SHEEP_COLOR);
+			}
+			//draw dogs
+			for(uint32_t d=0;d<world.dogs.size();d++){
+				glm::vec2 dog = (d < previous_dogs.size() ? glm::mix(previous_dogs[d],world.dogs[d],alpha) : world.dogs[d]);
+				draw.add_rectangle(dog-DOG_SCALE*rad2,dog+DOG_SCALE*rad2,DOG_COLOR);
+			}
 
 			draw.draw();
 		}
@@ -324,6 +222,18 @@ int main(int argc, char **argv) {
 
 	//------------  teardown ------------
 
+	if (!config.record.empty()) {
+		log.finish(world);
+		try {
+			log.save(config.record);
+			std::cout << "Recorded " << log.ticks << " ticks (" << log.bytes.size() << " bytes) to '" << config.record << "'." << std::endl;
+		} catch (std::exception &e) {
+			std::cerr << "ERROR: " << e.what() << std::endl;
+		}
+	}
+
+	scenery.release(); //(while there is still a context to free it from)
+
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
@@ -0,0 +1,332 @@
+//sim_bench steps the sheep simulation with no window or GL context and reports how fast it went.
+//usage: ./sim_bench [--sheep N] [--ticks M] [--seed S] [--threads T] [--tick-rate R] [--broadphase grid|sap|all] [--contacts ordered|colored] [--kinetic 0|1] [--packed 0|1] [--level FILE] [--dogs K] [--herd 0|1] [--snapshots K] [--replay LOG] [--batch G] [--check 0|1]
+
+#include "World.hpp"
+#include "Collide.hpp"
+#include "ThreadPool.hpp"
+#include "Kinetic.hpp"
+#include "Packed.hpp"
+#include "InputLog.hpp"
+#include "Batch.hpp"
+#include "Neighbors.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h> //used for sheep and dog positioning
+
+#define CHECK_NEAREST 8 //--check compares this many nearest neighbours per sheep
+#define CHECK_LONG_TICK_RATE 5.0f //--check also runs at this rate (sheep travel over two radii a step, so the swept tests kick in)
+
+static char const *broadphase_names[] = { "grid", "sap", "all-pairs" }; //by World::Broadphase
+
+int main(int argc, char **argv) {
+	//Configuration:
+	struct {
+		int sheep = 1000;
+		int ticks = 1000;
+		unsigned int seed = 1;
+		int threads = 1; //0 means one per hardware thread
+		World::Broadphase broadphase = World::UniformGrid;
+		World::Contacts contacts = World::Ordered;
+		float elapsed = 1.0f / 60.0f; //simulated time per tick
+		bool kinetic = false; //run event-to-event (see Kinetic.hpp) instead of stepping
+		bool packed = false; //step 8-byte sheep (see Packed.hpp)
+		std::string level; //fences and rocks to load (default: the plain pen)
+		int dogs = 1; //dogs circling the pen (kinetic and packed follow the first only)
+		bool herding = false; //boids-style herding (see World::herding; not in kinetic or packed)
+		int snapshots = 0; //afterwards, time this many World::snapshot() + restore() round trips
+		std::string replay; //play back a session recorded by ./main --record (ignores the sheep/seed/tick/dog/herd options)
+		int batch = 0; //step this many independent SHEEP_COUNT-sheep games at once (see Batch.hpp; ignores --sheep)
+		bool check = false; //afterwards, run again with every broadphase and check they all end in the same state
+	} config;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if (arg == "--sheep") {
+			config.sheep = atoi(argv[i+1]);
+		} else if (arg == "--ticks") {
+			config.ticks = atoi(argv[i+1]);
+		} else if (arg == "--seed") {
+			config.seed = strtoul(argv[i+1], NULL, 10);
+		} else if (arg == "--tick-rate") {
+			config.elapsed = 1.0f / float(atof(argv[i+1]));
+		} else if (arg == "--broadphase" && std::string(argv[i+1]) == "grid") {
+			config.broadphase = World::UniformGrid;
+		} else if (arg == "--broadphase" && std::string(argv[i+1]) == "sap") {
+			config.broadphase = World::SortAndSweep;
+		} else if (arg == "--broadphase" && std::string(argv[i+1]) == "all") {
+			config.broadphase = World::AllPairs;
+		} else if (arg == "--check") {
+			config.check = atoi(argv[i+1]) != 0;
+		} else if (arg == "--kinetic") {
+			config.kinetic = atoi(argv[i+1]) != 0;
+		} else if (arg == "--packed") {
+			config.packed = atoi(argv[i+1]) != 0;
+		} else if (arg == "--contacts" && std::string(argv[i+1]) == "ordered") {
+			config.contacts = World::Ordered;
+		} else if (arg == "--contacts" && std::string(argv[i+1]) == "colored") {
+			config.contacts = World::Colored;
+		} else if (arg == "--level") {
+			config.level = argv[i+1];
+		} else if (arg == "--replay") {
+			config.replay = argv[i+1];
+		} else if (arg == "--batch") {
+			config.batch = atoi(argv[i+1]);
+		} else if (arg == "--snapshots") {
+			config.snapshots = atoi(argv[i+1]);
+		} else if (arg == "--herd") {
+			config.herding = atoi(argv[i+1]) != 0;
+		} else if (arg == "--dogs") {
+			config.dogs = std::max(1, atoi(argv[i+1]));
+		} else if (arg == "--threads") {
+			config.threads = atoi(argv[i+1]);
+		} else {
+			std::cerr << "Unknown option '" << arg << "'." << std::endl;
+			std::cerr << "usage: " << argv[0] << " [--sheep N] [--ticks M] [--seed S] [--threads T] [--tick-rate R] [--broadphase grid|sap|all] [--contacts ordered|colored] [--kinetic 0|1] [--packed 0|1] [--level FILE] [--dogs K] [--herd 0|1] [--snapshots K] [--replay LOG] [--batch G] [--check 0|1]" << std::endl;
+			return 1;
+		}
+	}
+	if (config.sheep <= 0 || config.ticks <= 0 || config.threads < 0 || !(config.elapsed > 0.0f)) {
+		std::cerr << "Need at least one sheep, one tick, a thread count >= 0, and a positive tick rate." << std::endl;
+		return 1;
+	}
+
+	//------------  replay ------------
+	if (!config.replay.empty()) {
+		InputLog log;
+		World world;
+		try {
+			log.load(config.replay);
+			world = log.start();
+		} catch (std::exception &e) {
+			std::cerr << "ERROR: " << e.what() << std::endl;
+			return 1;
+		}
+		ThreadPool pool(config.threads);
+		world.pool = &pool;
+		world.broadphase = config.broadphase; //(broadphase and threads don't change results; contacts would)
+		float tick = log.tick();
+		std::vector< glm::vec2 > dogs;
+		uint32_t ticks = 0, pauses = 0;
+		auto start_time = std::chrono::high_resolution_clock::now();
+		InputLog::Reader reader(log);
+		try {
+			while (reader.next()) {
+				pauses += reader.toggles;
+				log.dogs(world, reader.mouse, &dogs);
+				world.step(tick, dogs.data(), uint32_t(dogs.size()));
+				ticks += 1;
+			}
+		} catch (std::exception &e) {
+			std::cerr << "ERROR: " << e.what() << std::endl;
+			return 1;
+		}
+		double seconds = std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - start_time).count();
+		if (ticks != log.ticks) {
+			std::cerr << "ERROR: '" << config.replay << "' says it has " << log.ticks << " ticks, but holds " << ticks << "." << std::endl;
+			return 1;
+		}
+		printf("replayed %u ticks of %u sheep in %.3f s (%u pause toggles, %.1f bytes/tick)\n", ticks, world.flock.size(), seconds,
+			pauses, double(log.bytes.size()) / std::max(ticks, 1U));
+		printf("  %.1f ticks/sec\n", ticks / seconds);
+		printf("  game %s at %.2f s\n", (world.game_over ? "over" : "running"), world.total_time);
+		if (log.fingerprint != 0 && InputLog::fingerprint_of(world) != log.fingerprint) {
+			printf("  final state DIFFERS from the recording\n");
+			return 1;
+		}
+		if (log.fingerprint != 0) printf("  final state matches the recording\n");
+		return 0;
+	}
+
+	//the level is loaded once, up front, so a bad file is reported before anything runs:
+	Obstacles level;
+	if (!config.level.empty()) {
+		try {
+			level.load(config.level);
+		} catch (std::exception &e) {
+			std::cerr << "ERROR: " << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	//------------  batch ------------
+	if (config.batch > 0) {
+		BatchWorld batch(config.batch, SHEEP_COUNT, config.seed);
+		ThreadPool pool(config.threads);
+		batch.pool = &pool;
+		if (!config.level.empty()) batch.obstacles = level;
+		std::vector< glm::vec2 > dogs(batch.games);
+		uint32_t next_seed = config.seed + batch.games;
+		uint64_t ended = 0;
+		auto start_time = std::chrono::high_resolution_clock::now();
+		for (int t = 0; t < config.ticks; ++t) {
+			//each game's dog circles the pen, starting from a different place:
+			for (uint32_t k = 0; k < batch.games; ++k) {
+				float angle = t * config.elapsed + 6.2831853f * k / batch.games;
+				dogs[k] = 0.5f * glm::vec2(cosf(angle), sinf(angle));
+			}
+			batch.step_all(config.elapsed, dogs.data());
+			//games that end start over with a new seed, so every game is always running:
+			for (uint32_t k = 0; k < batch.games; ++k) {
+				if (!batch.game_over[k]) continue;
+				ended += 1;
+				batch.reset(k, next_seed++);
+			}
+		}
+		double seconds = std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - start_time).count();
+		printf("%u games of %u sheep, %d ticks in %.3f s (%u threads, %d games per block)\n", batch.games, batch.sheep, config.ticks, seconds, pool.size(), BATCH_LANES);
+		printf("  %.1f env-steps/sec\n", double(batch.games) * config.ticks / seconds);
+		printf("  %llu games ended (and started over)\n", (unsigned long long)ended);
+		return 0;
+	}
+
+	//------------  setup ------------
+	ThreadPool pool(config.threads);
+	auto setup = [&config,&pool,&level](World::Broadphase broadphase) {
+		World world(config.sheep, config.seed);
+		world.pool = &pool;
+		world.broadphase = broadphase;
+		world.contacts = config.contacts;
+		world.herding = config.herding;
+		if (!config.level.empty()) world.obstacles = level;
+
+		//the default ring placement piles large flocks on top of each other,
+		// so lay sheep out on a lattice inside the fence, shrunk to fit:
+		int side = int(ceilf(sqrtf(float(config.sheep))));
+		float inner = FENCE_BOUND - FENCE_RAD;
+		float spacing = 2.0f * inner / side;
+		world.radius = std::min(world.radius, 0.3f * spacing);
+		for (int i = 0; i < config.sheep; ++i) {
+			world.flock.set_pos(i, glm::vec2(
+				-inner + (i % side + 0.5f) * spacing,
+				-inner + (i / side + 0.5f) * spacing
+			));
+		}
+		return world;
+	};
+	auto run = [&config](World &world, float elapsed) {
+		std::vector< glm::vec2 > dogs(config.dogs);
+		for (int t = 0; t < config.ticks; ++t) {
+			//dogs circle the pen, evenly spaced:
+			for (int d = 0; d < config.dogs; ++d) {
+				float angle = t * elapsed + 6.2831853f * d / config.dogs;
+				dogs[d] = 0.5f * glm::vec2(cosf(angle), sinf(angle));
+			}
+			world.step(elapsed, dogs.data(), uint32_t(dogs.size()));
+		}
+	};
+	World world = setup(config.broadphase);
+
+	//------------  stepping ------------
+	auto start_time = std::chrono::high_resolution_clock::now();
+	uint64_t events = 0;
+	if (config.kinetic) {
+		Kinetic kinetic(world);
+		for (int t = 0; t < config.ticks; ++t) {
+			//dog circles the pen:
+			float angle = t * config.elapsed;
+			kinetic.advance(config.elapsed, 0.5f * glm::vec2(cosf(angle), sinf(angle)));
+		}
+		kinetic.sync(world);
+		events = kinetic.events;
+	} else if (config.packed) {
+		PackedWorld packed(world);
+		packed.pool = &pool;
+		for (int t = 0; t < config.ticks; ++t) {
+			//dog circles the pen:
+			float angle = t * config.elapsed;
+			packed.step(config.elapsed, 0.5f * glm::vec2(cosf(angle), sinf(angle)));
+		}
+		packed.unpack(world);
+	} else {
+		run(world, config.elapsed);
+	}
+	auto end_time = std::chrono::high_resolution_clock::now();
+
+	double seconds = std::chrono::duration< double >(end_time - start_time).count();
+	printf("%d sheep, %d dogs, %d ticks in %.3f s (%s box tests, %u threads, %s broadphase, %s contacts%s)\n", config.sheep, config.dogs, config.ticks, seconds, aabb_kernel_name(), pool.size(),
+		(config.kinetic ? "no" : config.packed ? "packed grid" : broadphase_names[world.broadphase]),
+		(world.contacts == World::Ordered ? "ordered" : "colored"), (world.herding ? ", herding" : ""));
+	printf("  %.1f ticks/sec\n", config.ticks / seconds);
+	printf("  %.2f ns/sheep\n", seconds * 1e9 / (double(config.ticks) * config.sheep));
+	if (config.kinetic) printf("  kinetic: %llu events\n", (unsigned long long)events);
+	printf("  game %s at %.2f s\n", (world.game_over ? "over" : "running"), world.total_time);
+	printf("  final state %016llx\n", (unsigned long long)InputLog::fingerprint_of(world));
+
+	if (config.check && !config.kinetic && !config.packed) {
+		//broadphases only choose which pairs get tested, so each must end exactly where testing every pair does.
+		//checked at the chosen --tick-rate and again at CHECK_LONG_TICK_RATE, where sheep travel more than two radii a step
+		// and bounced sheep get swept back (the case that needs the broadphases to widen their reach):
+		bool same = true;
+		for (float rate : { 1.0f / config.elapsed, CHECK_LONG_TICK_RATE }) {
+			World reference = setup(World::AllPairs);
+			run(reference, 1.0f / rate);
+			uint64_t expected = InputLog::fingerprint_of(reference);
+			uint64_t fingerprints[2];
+			for (World::Broadphase broadphase : { World::UniformGrid, World::SortAndSweep }) {
+				World other = setup(broadphase);
+				run(other, 1.0f / rate);
+				fingerprints[broadphase] = InputLog::fingerprint_of(other);
+				bool matches = (fingerprints[broadphase] == expected);
+				printf("  check at %g Hz: %s broadphase %s all pairs\n", rate, broadphase_names[broadphase], (matches ? "matches" : "DIFFERS from"));
+				same = same && matches;
+			}
+			bool agree = (fingerprints[World::UniformGrid] == fingerprints[World::SortAndSweep]);
+			printf("  check at %g Hz: grid and sap broadphases %s\n", rate, (agree ? "agree" : "DISAGREE"));
+			same = same && agree;
+		}
+
+		//neighbour queries on the final flock must find what looking at every sheep finds
+		// (queries from just outside the bounds too, where points clamp into the edge cells):
+		Neighbors neighbors;
+		float range = HERD_RANGE * world.radius;
+		glm::vec2 corner = glm::vec2(FENCE_BOUND, FENCE_BOUND);
+		neighbors.build(world.flock.x.data(), world.flock.y.data(), world.flock.size(), -corner, corner, range);
+		uint32_t slots = world.flock.size(), wrong = 0;
+		std::vector< uint32_t > found, expected;
+		std::vector< Neighbors::Hit > closest, all;
+		for (uint32_t q = 0; q < slots + 4; ++q) {
+			glm::vec2 p = (q < slots ? world.flock.pos(q) : 1.1f * corner * glm::vec2(q % 2 ? 1.0f : -1.0f, q % 4 < 2 ? 1.0f : -1.0f));
+			found.clear();
+			neighbors.within(p, range, &found);
+			std::sort(found.begin(), found.end());
+			expected.clear();
+			all.clear();
+			for (uint32_t k = 0; k < slots; ++k) {
+				float dx = neighbors.x[k] - p.x, dy = neighbors.y[k] - p.y;
+				if (dx * dx + dy * dy < range * range) expected.emplace_back(k);
+				all.emplace_back(Neighbors::Hit{dx * dx + dy * dy, k});
+			}
+			std::sort(all.begin(), all.end(), [](Neighbors::Hit const &a, Neighbors::Hit const &b) {
+				return a.distance2 < b.distance2 || (a.distance2 == b.distance2 && a.slot < b.slot);
+			});
+			if (all.size() > CHECK_NEAREST) all.resize(CHECK_NEAREST);
+			neighbors.nearest(p, CHECK_NEAREST, &closest);
+			bool same_nearest = (closest.size() == all.size());
+			for (uint32_t k = 0; same_nearest && k < all.size(); ++k) {
+				same_nearest = (closest[k].slot == all[k].slot && closest[k].distance2 == all[k].distance2);
+			}
+			if (found != expected || !same_nearest) wrong += 1;
+		}
+		printf("  check: neighbour queries %s looking at every sheep (%u of %u differ)\n", (wrong ? "DIFFER from" : "match"), wrong, slots + 4);
+		if (wrong) same = false;
+		if (!same) return 1;
+	}
+
+	if (config.snapshots > 0) {
+		WorldState state;
+		auto snap_start = std::chrono::high_resolution_clock::now();
+		for (int s = 0; s < config.snapshots; ++s) {
+			world.snapshot(&state);
+			world.restore(state);
+		}
+		double snap_seconds = std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - snap_start).count();
+		printf("  %.1f snapshot+restore/sec (%.1f KB each)\n", config.snapshots / snap_seconds, state.bytes() / 1024.0);
+	}
+
+	return 0;
+}